@@ -0,0 +1,27 @@
+#!/bin/bash
+
+# Write the binary version (.cmesh) of every OBJ file of assets/, loaded instead of the OBJ by the program.
+# The program must have been compiled first (see linux_compile_run_cmake.py).
+
+import os
+import glob
+
+basedir = os.path.dirname(__file__)
+
+full_path = os.path.dirname(os.path.abspath(__file__))
+executable_name = full_path.split('/')[-2]
+
+
+def run_cmd(cmd):
+    full_cmd = ''
+    if basedir!='':
+        full_cmd = 'cd '+basedir+'; '
+    full_cmd += 'cd ..; '+cmd
+    print(full_cmd)
+    os.system(full_cmd)
+
+root = os.path.dirname(full_path)
+obj_files = sorted(glob.glob(os.path.join(root,'assets','**','*.obj'), recursive=True))
+obj_files = [os.path.relpath(f,root) for f in obj_files]
+
+run_cmd('./build/'+executable_name+' --convert-meshes '+' '.join('"'+f+'"' for f in obj_files))
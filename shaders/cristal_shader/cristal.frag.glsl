@@ -18,7 +18,7 @@ in struct fragment_data
     vec3 normal;   // normal in the world space
     vec3 color;    // current color on the fragment
     vec2 uv;       // current uv-texture on the fragment
-
+    float texture_index; // 0: image_texture, 1: image_texture_2 (instanced crystals)
 } fragment;
 
 // Output of the fragment shader - output color
@@ -29,10 +29,25 @@ layout(location=0) out vec4 FragColor;
 // ***************************************************** //
 
 uniform sampler2D image_texture;   // Texture image identifiant
+uniform sampler2D image_texture_2; // Second texture of the instanced crystals
 
 uniform mat4 view;       // View matrix (rigid transform) of the camera - to compute the camera position
 
-uniform vec3 light; // position of the light
+// Lights shared by every shader, uploaded once per frame (see environment_structure::send_lights)
+struct light_params{
+	vec3 position;
+	float distance;
+	vec3 color;
+	float intensity;
+};
+layout(std140) uniform lights_block {
+	light_params lights[256];
+	vec3 light;      // position of the single light
+	bool multilight; // use the lights array instead of the single light
+	int num_light;   // number of lights used in the array
+	ivec4 cluster_size;  // number of clusters along x, y, z (screen tiles and depth slices), and width of light_indices
+	vec4 cluster_depth;  // depth slice of a fragment: log(depth/cluster_depth.x)*cluster_depth.y
+};
 
 
 // Coefficients of phong illumination model
@@ -62,18 +77,6 @@ struct material_structure
 
 uniform material_structure material;
 
-uniform bool multilight = false;
-
-
-struct light_params{
-	vec3 position;
-	vec3 color;
-	float distance;
-	float intensity;
-};
-int num_light = 8;
-
-
 
 uniform float time;
 
@@ -115,7 +118,13 @@ void main()
 	}
 
 	// Get the current texture color
-	vec4 color_image_texture = texture(image_texture, uv_image);
+	vec4 color_image_texture;
+	if(fragment.texture_index > 0.5) {
+		color_image_texture = texture(image_texture_2, uv_image);
+	}
+	else {
+		color_image_texture = texture(image_texture, uv_image);
+	}
 	if(material.texture_settings.use_texture == false) {
 		color_image_texture=vec4(1.0,1.0,1.0,1.0);
 	}
@@ -15,6 +15,7 @@ out struct fragment_data
     vec3 normal;   // normal position in world space
     vec3 color;    // vertex color
     vec2 uv;       // vertex uv
+    float texture_index; // always the first texture
 } fragment;
 
 // Uniform variables expected to receive from the C++ program
@@ -41,6 +42,7 @@ void main()
 	fragment.normal   = normal.xyz;
 	fragment.color = vertex_color;
 	fragment.uv = vertex_uv;
+	fragment.texture_index = 0.0;
 
 	// gl_Position is a built-in variable which is the expected output of the vertex shader
 	gl_Position = position_projected; // gl_Position is the projected vertex position (in normalized device coordinates)
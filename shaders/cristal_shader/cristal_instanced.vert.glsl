@@ -0,0 +1,62 @@
+#version 330 core
+
+// Vertex shader of the instanced crystals (see cristal_renderer) - this code is executed for every vertex of every crystal
+// The transform of each crystal is read from per instance attributes instead of the model matrix
+
+// Inputs coming from VBOs
+layout (location = 0) in vec3 vertex_position; // vertex position in local space (x,y,z)
+layout (location = 1) in vec3 vertex_normal;   // vertex normal in local space   (nx,ny,nz)
+layout (location = 2) in vec3 vertex_color;    // vertex color      (r,g,b)
+layout (location = 3) in vec2 vertex_uv;       // vertex uv-texture (u,v)
+
+// Inputs coming from the instance VBOs (one value per crystal)
+layout (location = 4) in vec3 instance_translation;
+layout (location = 5) in vec4 instance_rotation; // quaternion (x,y,z,w)
+layout (location = 6) in vec3 instance_scaling;  // scaling x scaling_xyz
+layout (location = 7) in float instance_texture; // 0: image_texture, 1: image_texture_2
+layout (location = 8) in vec3 instance_color;
+
+// Output variables sent to the fragment shader
+out struct fragment_data
+{
+    vec3 position; // vertex position in world space
+    vec3 normal;   // normal position in world space
+    vec3 color;    // vertex color
+    vec2 uv;       // vertex uv
+    float texture_index;
+} fragment;
+
+// Uniform variables expected to receive from the C++ program
+uniform mat4 model; // Transform applied to every crystal (identity by default)
+uniform mat4 view;  // View matrix (rigid transform) of the camera
+uniform mat4 projection; // Projection (perspective or orthogonal) matrix of the camera
+
+
+// Rotation of v by the unit quaternion q
+vec3 rotate(vec4 q, vec3 v)
+{
+	return v + 2.0*cross(q.xyz, cross(q.xyz, v) + q.w*v);
+}
+
+void main()
+{
+	// The position of the vertex in the world space
+	vec3 p = instance_translation + rotate(instance_rotation, instance_scaling*vertex_position);
+	vec4 position = model * vec4(p, 1.0);
+
+	// The normal of the vertex in the world space (inverse transpose of the scaling)
+	vec3 n = rotate(instance_rotation, vertex_normal/instance_scaling);
+	vec4 normal = model * vec4(n, 0.0);
+
+	// The projected position of the vertex in the normalized device coordinates:
+	vec4 position_projected = projection * view * position;
+
+	// Fill the parameters sent to the fragment shader
+	fragment.position = position.xyz;
+	fragment.normal   = normal.xyz;
+	fragment.color = vertex_color * instance_color;
+	fragment.uv = vertex_uv;
+	fragment.texture_index = instance_texture;
+
+	gl_Position = position_projected;
+}
@@ -0,0 +1,7 @@
+#version 330 core
+
+// Fragment shader of the depth pre-pass: only the depth is written
+
+void main()
+{
+}
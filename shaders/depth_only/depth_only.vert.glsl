@@ -0,0 +1,19 @@
+#version 330 core
+
+// Vertex shader of the depth pre-pass (see render_queue)
+//  The position must be computed exactly as in the shaders of the shading pass (same expression, invariant gl_Position),
+//  so that their fragments pass the equal depth test
+
+layout (location = 0) in vec3 vertex_position; // vertex position in local space (x,y,z)
+
+uniform mat4 model; // Model affine transform matrix associated to the current shape
+uniform mat4 view;  // View matrix (rigid transform) of the camera
+uniform mat4 projection; // Projection (perspective or orthogonal) matrix of the camera
+
+invariant gl_Position;
+
+void main()
+{
+	vec4 position = model * vec4(vertex_position, 1.0);
+	gl_Position = projection * view * position;
+}
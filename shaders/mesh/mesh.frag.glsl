@@ -31,8 +31,26 @@ layout(location=0) out vec4 FragColor;
 uniform sampler2D image_texture;   // Texture image identifiant
 
 uniform mat4 view;       // View matrix (rigid transform) of the camera - to compute the camera position
+uniform mat4 projection; // Projection matrix of the camera - to find the cluster of the fragment
 
-uniform vec3 light; // position of the light
+// Lights shared by every shader, uploaded once per frame (see environment_structure::send_lights)
+struct light_params{
+	vec3 position;
+	float distance;
+	vec3 color;
+	float intensity;
+};
+layout(std140) uniform lights_block {
+	light_params lights[256];
+	vec3 light;      // position of the single light
+	bool multilight; // use the lights array instead of the single light
+	int num_light;   // number of lights used in the array
+	ivec4 cluster_size;  // number of clusters along x, y, z (screen tiles and depth slices), and width of light_indices
+	vec4 cluster_depth;  // depth slice of a fragment: log(depth/cluster_depth.x)*cluster_depth.y
+};
+// Lights reaching each cluster of the view volume (see light_clusters)
+uniform usampler2D light_clusters; // first index in light_indices and number of lights of the cluster
+uniform usampler2D light_indices;  // indices in the lights array
 
 
 // Coefficients of phong illumination model
@@ -62,67 +80,24 @@ struct material_structure
 
 uniform material_structure material;
 
-uniform bool multilight = false;
-
-uniform vec3 light_0_pos;
-uniform vec3 light_1_pos;
-uniform vec3 light_2_pos;
-uniform vec3 light_3_pos;
-uniform vec3 light_4_pos;
-uniform vec3 light_5_pos;
-uniform vec3 light_6_pos;
-uniform vec3 light_7_pos;
-
-uniform vec3 light_0_color;
-uniform vec3 light_1_color;
-uniform vec3 light_2_color;
-uniform vec3 light_3_color;
-uniform vec3 light_4_color;
-uniform vec3 light_5_color;
-uniform vec3 light_6_color;
-uniform vec3 light_7_color;
-
-uniform float light_0_dist;
-uniform float light_1_dist;
-uniform float light_2_dist;
-uniform float light_3_dist;
-uniform float light_4_dist;
-uniform float light_5_dist;
-uniform float light_6_dist;
-uniform float light_7_dist;
-
-uniform float light_0_intensity;
-uniform float light_1_intensity;
-uniform float light_2_intensity;
-uniform float light_3_intensity;
-uniform float light_4_intensity;
-uniform float light_5_intensity;
-uniform float light_6_intensity;
-uniform float light_7_intensity;
-
-struct light_params{
-	vec3 position;
-	vec3 color;
-	float distance;
-	float intensity;
-};
-int num_light = 8;
-light_params lights[8] = light_params[](
-	light_params(light_0_pos,light_0_color,light_0_dist,light_0_intensity),
-	light_params(light_1_pos,light_1_color,light_1_dist,light_1_intensity),
-	light_params(light_2_pos,light_2_color,light_2_dist,light_2_intensity),
-	light_params(light_3_pos,light_3_color,light_3_dist,light_3_intensity),
-	light_params(light_4_pos,light_4_color,light_4_dist,light_4_intensity),
-	light_params(light_5_pos,light_5_color,light_5_dist,light_5_intensity),
-	light_params(light_6_pos,light_6_color,light_6_dist,light_6_intensity),
-	light_params(light_7_pos,light_7_color,light_7_dist,light_7_intensity)
-	);
 
 uniform float time;
 
 vec3 computeColorWithLights(vec3 color_object,vec3 N,vec3 camera_position,vec3 fragment_position,float Ka,float Kd,float Ks,float specular_exponent){
 	vec3 color_shading = Ka * color_object;
-	for(int i=0;i<num_light;i++){
+
+	// Cluster of the fragment: screen tile, and depth slice on a logarithmic scale
+	vec4 clip = projection * view * vec4(fragment_position,1.0);
+	vec2 ndc = clip.xy/max(clip.w,1e-5);
+	ivec3 cluster = ivec3(floor((ndc*0.5+0.5)*vec2(cluster_size.xy)), 0);
+	if(clip.w>cluster_depth.x)
+		cluster.z = int(floor(log(clip.w/cluster_depth.x)*cluster_depth.y));
+	cluster = clamp(cluster, ivec3(0), cluster_size.xyz-1);
+	uvec2 range = texelFetch(light_clusters, ivec2(cluster.y*cluster_size.x+cluster.x, cluster.z), 0).xy;
+
+	for(uint k=0u;k<range.y;k++){
+		int index = int(range.x+k);
+		int i = int(texelFetch(light_indices, ivec2(index%cluster_size.w, index/cluster_size.w), 0).r);
 		// Unit direction toward the light
 		vec3 L = normalize(lights[i].position-fragment.position);
 		float distance = length(lights[i].position-fragment.position);
@@ -156,7 +131,6 @@ vec3 computeColorWithLights(vec3 color_object,vec3 N,vec3 camera_position,vec3 f
 }
 
 
-
 uniform bool has_fog;
 uniform float fog_distance;
 uniform vec3 fog_color;
@@ -25,6 +25,9 @@ uniform mat4 model; // Model affine transform matrix associated to the current s
 uniform mat4 view;  // View matrix (rigid transform) of the camera
 uniform mat4 projection; // Projection (perspective or orthogonal) matrix of the camera
 
+// Same position as the depth pre-pass (see shaders/depth_only)
+invariant gl_Position;
+
 uniform float time;
 
 
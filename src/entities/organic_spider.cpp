@@ -1,5 +1,6 @@
 #include "organic_spider.hpp"
 #include "../utils/math.hpp"
+#include "../utils/asset_registry.hpp"
 
 
 bool organic_spider::textureInitialized = false;
@@ -9,68 +10,95 @@ material_mesh_drawable_phong organic_spider::material;
 
 
 
-mesh organic_spider::getLegMesh(leg whichLeg, bone whichBone, float &scaling){
+std::string organic_spider::getLegPath(leg whichLeg, bone whichBone, float &scaling){
     float length = getBoneLength(whichLeg,whichBone);
-    mesh mesh = mesh_primitive_cylinder(0.03f,{0,0,0},{0,length,0});
+    std::string path;
     if(whichLeg==FrontLeft || whichLeg==FrontRight){
         if(whichBone==BaseBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_front_1.obj");
+            path = "assets/spider/legs/spider_front_1.obj";
             scaling = length/0.308f;
         }
         else if(whichBone==MiddleBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_front_2_bis.obj");
+            path = "assets/spider/legs/spider_front_2_bis.obj";
             scaling = length/0.347f;
         }
         else if(whichBone==FootBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_front_3.obj");
+            path = "assets/spider/legs/spider_front_3.obj";
             scaling = length/0.45f;
         }
     }
     else if(whichLeg==MiddleLeft || whichLeg==MiddleRight){
         if(whichBone==BaseBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_middle_1.obj");
+            path = "assets/spider/legs/spider_middle_1.obj";
             scaling = length/0.40f;
         }
         else if(whichBone==MiddleBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_middle_2.obj");
+            path = "assets/spider/legs/spider_middle_2.obj";
             scaling = length/0.38f;
         }
         else if(whichBone==FootBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_middle_3.obj");
+            path = "assets/spider/legs/spider_middle_3.obj";
             scaling = length/0.45f;
         }
     }
     else if(whichLeg==Middle2Left || whichLeg==Middle2Right){
         if(whichBone==BaseBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_middle2_1.obj");
+            path = "assets/spider/legs/spider_middle2_1.obj";
             scaling = length/0.37f;
         }
         else if(whichBone==MiddleBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_middle2_2.obj");
+            path = "assets/spider/legs/spider_middle2_2.obj";
             scaling = length/0.37f;
         }
         else if(whichBone==FootBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_middle2_3.obj");
+            path = "assets/spider/legs/spider_middle2_3.obj";
             scaling = length/0.45f;
         }
     }
     else if(whichLeg==BackLeft || whichLeg==BackRight){
         if(whichBone==BaseBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_back_1.obj");
+            path = "assets/spider/legs/spider_back_1.obj";
             scaling = length/0.36f;
         }
         else if(whichBone==MiddleBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_back_2.obj");
+            path = "assets/spider/legs/spider_back_2.obj";
             scaling = length/0.33f;
         }
         else if(whichBone==FootBone){
-            mesh = mesh_load_file_obj(project::path+"assets/spider/legs/spider_back_3.obj");
+            path = "assets/spider/legs/spider_back_3.obj";
             scaling = length/0.50f;
         }
     }
-    return mesh;
+    return path;
 }
 
+mesh_drawable organic_spider::getLegMesh(leg whichLeg, bone whichBone, float &scaling){
+    std::string const path = getLegPath(whichLeg,whichBone,scaling);
+    if(path.empty()){
+        float length = getBoneLength(whichLeg,whichBone);
+        mesh_drawable cylinder;
+        cylinder.initialize_data_on_gpu(mesh_primitive_cylinder(0.03f,{0,0,0},{0,length,0}));
+        return cylinder;
+    }
+    // Left and right legs, and every spider, share the same buffers
+    return asset_registry::get_drawable(project::path+path);
+}
+
+
+void organic_spider::addAssets(asset_loader &loader){
+    float scaling;
+    for(int whichLeg=FrontLeft;whichLeg<=BackRight;whichLeg++){
+        for(int whichBone=BaseBone;whichBone<=FootBone;whichBone++){
+            std::string const path = getLegPath(leg(whichLeg),bone(whichBone),scaling);
+            if(!path.empty()){
+                loader.add_mesh(project::path+path);
+            }
+        }
+    }
+    loader.add_mesh(project::path+"assets/spider/spider_body.obj",true);
+    loader.add_texture(getTexturePath(),GL_REPEAT,GL_REPEAT);
+    loader.add_texture(project::path+"assets/spider/textures/spider1_nmap.jpg",GL_REPEAT,GL_REPEAT);
+}
 
 void organic_spider::initialize(){
     mesh_drawable body;
@@ -78,43 +106,19 @@ void organic_spider::initialize(){
     material.phong.specular = 0.1f;
 
     if(!textureInitialized){
-        texture.load_and_initialize_texture_2d_on_gpu(getTexturePath(),GL_REPEAT,GL_REPEAT);
-        normal_texture.load_and_initialize_texture_2d_on_gpu(project::path+"assets/spider/textures/spider1_nmap.jpg",GL_REPEAT,GL_REPEAT);
+        texture = asset_registry::get_texture(getTexturePath(),GL_REPEAT,GL_REPEAT);
+        normal_texture = asset_registry::get_texture(project::path+"assets/spider/textures/spider1_nmap.jpg",GL_REPEAT,GL_REPEAT);
         textureInitialized = true;
     }
 
-    mesh body_mesh = mesh_load_file_obj(project::path+"assets/spider/spider_body.obj");
-    body.initialize_data_on_gpu(body_mesh);
-    body.model.scaling = 1.5;
-    
-    numarray<vec3> tangents_body;
-    numarray<vec3> bitangents_body;
-    tangents_body.resize(body_mesh.position.size());
-    bitangents_body.resize(body_mesh.position.size());
-    for(int i=0;i<body_mesh.connectivity.size();i++){
-        uint3 indexes = body_mesh.connectivity[i];
-        int idx = indexes[0];
-        int idx2 = indexes[1];
-        int idx3 = indexes[2];
-        /*vec3 pos1 = body_mesh.position[indexes[0]];
-        vec3 pos2 = body_mesh.position[indexes[1]];
-        vec3 pos3 = body_mesh.position[indexes[2]];
-        vec2 uv1 = body_mesh.uv[indexes[0]];
-        vec2 uv2 = body_mesh.uv[indexes[1]];
-        vec2 uv3 = body_mesh.uv[indexes[2]];
-        vec3 normal = body_mesh.normal[]*/
-
-        tangents_body[idx] = math::calculate_tangent(body_mesh.position[idx],body_mesh.position[idx2],body_mesh.position[idx3],body_mesh.uv[idx],body_mesh.uv[idx2],body_mesh.uv[idx3],body_mesh.normal[idx]);
-        bitangents_body[idx] = math::calculate_bitangent(tangents_body[idx],body_mesh.normal[idx]);
-        idx = indexes[1];idx2 = indexes[2];idx3 = indexes[0];  
-        tangents_body[idx] = math::calculate_tangent(body_mesh.position[idx],body_mesh.position[idx2],body_mesh.position[idx3],body_mesh.uv[idx],body_mesh.uv[idx2],body_mesh.uv[idx3],body_mesh.normal[idx]);
-        bitangents_body[idx] = math::calculate_bitangent(tangents_body[idx],body_mesh.normal[idx]);
-        idx = indexes[2];idx2 = indexes[0];idx3 = indexes[1];  
-        tangents_body[idx] = math::calculate_tangent(body_mesh.position[idx],body_mesh.position[idx2],body_mesh.position[idx3],body_mesh.uv[idx],body_mesh.uv[idx2],body_mesh.uv[idx3],body_mesh.normal[idx]);
-        bitangents_body[idx] = math::calculate_bitangent(tangents_body[idx],body_mesh.normal[idx]);
+    std::string const body_path = project::path+"assets/spider/spider_body.obj";
+    mesh_drawable &shared_body = asset_registry::get_drawable(body_path);
+    if(shared_body.supplementary_vbo.empty()){
+        shared_body.initialize_supplementary_data_on_gpu(asset_registry::get_tangents(body_path),4);
+        shared_body.initialize_supplementary_data_on_gpu(asset_registry::get_bitangents(body_path),5);
     }
-    body.initialize_supplementary_data_on_gpu(tangents_body,4);
-    body.initialize_supplementary_data_on_gpu(bitangents_body,5);
+    body = shared_body;
+    body.model.scaling = 1.5;
     
     body.shader = cave_mesh::getShader();
     body.texture = texture;
@@ -160,7 +164,6 @@ void organic_spider::initialize(){
 
 void organic_spider::initializeLegHierarchy(leg whichLeg, vec3 bindPosition)
 {
-    mesh_drawable articulation;
     mesh_drawable bone1;
     mesh_drawable bone2;
     mesh_drawable bone3;
@@ -168,14 +171,13 @@ void organic_spider::initializeLegHierarchy(leg whichLeg, vec3 bindPosition)
     std::string baseName = getLegPrefix(whichLeg);
     float scaling = 1;
 
-    articulation.initialize_data_on_gpu(mesh_primitive_sphere(0.025f));
-    bone1.initialize_data_on_gpu(getLegMesh(whichLeg,BaseBone,scaling));
+    bone1 = getLegMesh(whichLeg,BaseBone,scaling);
     bone1.model.scaling = scaling; scaling = 1;
     bone1.material = material;
-    bone2.initialize_data_on_gpu(getLegMesh(whichLeg,MiddleBone,scaling));
+    bone2 = getLegMesh(whichLeg,MiddleBone,scaling);
     bone2.model.scaling = scaling; scaling = 1;
     bone2.material = material;
-    bone3.initialize_data_on_gpu(getLegMesh(whichLeg,FootBone,scaling));
+    bone3 = getLegMesh(whichLeg,FootBone,scaling);
     bone3.model.scaling = scaling; scaling = 1;
     bone3.material = material;
 
@@ -3,6 +3,7 @@
 
 #include "spider.hpp"
 #include "../map/cave_mesh.hpp"
+#include "../utils/asset_loader.hpp"
 
 
 class organic_spider: public spider{
@@ -11,7 +12,8 @@ class organic_spider: public spider{
         static opengl_texture_image_structure texture;
         static opengl_texture_image_structure normal_texture;
         static material_mesh_drawable_phong material;
-        mesh getLegMesh(leg whichLeg, bone whichBone, float &scaling);
+        std::string getLegPath(leg whichLeg, bone whichBone, float &scaling); // Relative path of the OBJ file, empty for a cylinder
+        mesh_drawable getLegMesh(leg whichLeg, bone whichBone, float &scaling);
         void initializeLegHierarchy(leg whichLeg, vec3 bindPosition) override;
         std::string getTexturePath();
     public:
@@ -19,6 +21,7 @@ class organic_spider: public spider{
         ~organic_spider(){}
 
 
+        void addAssets(asset_loader &loader); // Files loaded by initialize()
         void initialize() override;
         float getBoneLength(leg whichLeg,bone whichBone) override;
         
@@ -82,7 +82,8 @@ void spider::initialize(){
     updateLegHierarchy(Middle2Right,"middle_arm2_right");
 }
 
-void spider::draw(environment_structure environment){
+void spider::draw(environment_structure const& environment){
+    profiler::scope section(environment.timings, "spider");
     spider_hierarchy["body"].transform_local.translation = translation;
     spider_hierarchy["body"].transform_local.rotation = rotation;
 
@@ -113,8 +114,24 @@ void spider::draw(environment_structure environment){
     updateLegHierarchy(Middle2Left,"middle_arm2_left");
     updateLegHierarchy(Middle2Right,"middle_arm2_right");
 
+    // The global frames are still updated, only the draw is skipped out of view
     spider_hierarchy.update_local_to_global_coordinates();
-    cgp::draw(spider_hierarchy,environment);
+    if(environment.view_frustum.is_sphere_visible(translation,getBoundingRadius())){
+        environment.draw(spider_hierarchy);
+    }
+}
+
+float spider::getBoundingRadius(){
+    // Body and tail, plus the longest leg fully extended
+    float reach = 0;
+    for(int whichLeg=FrontLeft;whichLeg<=BackRight;whichLeg++){
+        float length = 0;
+        for(int whichBone=BaseBone;whichBone<=FootBone;whichBone++){
+            length += getBoneLength(leg(whichLeg),bone(whichBone));
+        }
+        reach = std::max(reach,length);
+    }
+    return 1.0f + reach;
 }
 void spider::updateGlobal(){
     spider_hierarchy.update_local_to_global_coordinates();
@@ -34,10 +34,11 @@ public:
 
     virtual void initialize();
 
-    void draw(environment_structure environment);
+    void draw(environment_structure const& environment);
 
     void updateGlobal();
     virtual float getBoneLength(leg whichLeg,bone whichBone);
+    float getBoundingRadius(); // Sphere around translation containing the whole spider
     void setLegPosition(leg whichLeg, vec3 target, bool debug=false);
     void updateTranslation(){spider_hierarchy["body"].transform_local.translation = translation;}
     void updateRotation(){spider_hierarchy["body"].transform_local.rotation = rotation;}
@@ -195,7 +195,8 @@ void SpiderController::smoothHeight(bool average)
     }
 }
 
-void SpiderController::debug_draw(environment_structure environment){
+void SpiderController::debug_draw(environment_structure const& environment){
+    profiler::scope section(environment.timings, "debug");
     if(debug.debug_stick_to_ground){
         for(auto ray : debug.rays_to_draw){
             ray.draw(environment);
@@ -116,7 +116,7 @@ public:
     void initialize(spider* _ControlledSpider,timer_basic* _timer,input_devices& _inputs, window_structure& window);
     bool stick_to_ground(collision_object* col, bool reset = true);
     void update(collision_object* col);
-    void debug_draw(environment_structure environment);
+    void debug_draw(environment_structure const& environment);
 
     // Control handlers
     void handleVelocity(float dt);
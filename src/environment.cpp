@@ -1,5 +1,10 @@
 #include "environment.hpp"
 
+#include <cstring>
+#include <unordered_map>
+
+#include "utils/light_clusters.hpp"
+
 // Change these global values to modify the default behavior
 // ************************************************************* //
 // The initial zoom factor on the GUI
@@ -22,33 +27,196 @@ std::string project::path = "";
 
 
 
-void environment_structure::send_opengl_uniform(opengl_shader_structure const& shader, bool expected) const
+// Memory layout of the lights_block uniform block (std140: a vec3 followed by a float fills 16 bytes)
+struct light_block_std140 {
+	struct light {
+		vec3 position;
+		float distance;
+		vec3 color;
+		float intensity;
+	} lights[environment_structure::max_lights];
+	vec3 light;
+	int multilight;
+	int light_count;
+	int padding[3];
+	int cluster_size[4]; // clusters along x, y, z, and width of the index texture
+	float cluster_depth[4]; // near distance and scale of the depth slices
+};
+static_assert(sizeof(light_block_std140) == 32*environment_structure::max_lights + 64, "lights_block must follow the std140 layout");
+
+const int environment_structure::max_lights;
+const GLuint environment_structure::light_block_binding;
+const int environment_structure::light_clusters_unit;
+const int environment_structure::light_indices_unit;
+
+static GLuint light_block_buffer = 0;
+static light_clusters clusters;
+
+void environment_structure::send_lights() const
 {
-	opengl_uniform(shader, "projection", camera_projection, expected);
-	opengl_uniform(shader, "view", camera_view, expected);
-	opengl_uniform(shader, "light", light, false);
-	opengl_uniform(shader, "multilight", multiLight, false);
-	opengl_uniform(shader, "time", time, false);
-	
-	opengl_uniform(shader, "has_fog", has_fog, false);
-	opengl_uniform(shader, "fog_distance", fog_distance, false);
-	opengl_uniform(shader, "fog_color", fog_color, false);
-
-	for(int i=0;i<max_lights;i++){
-		if(i<lights.size()){
-			opengl_uniform(shader, "light_"+str(i)+"_pos", lights[i].position, false);
-			opengl_uniform(shader, "light_"+str(i)+"_color", lights[i].color, false);
-			opengl_uniform(shader, "light_"+str(i)+"_dist", lights[i].distance, false);
-			opengl_uniform(shader, "light_"+str(i)+"_intensity", lights[i].intensity, false);
-		}
-		else{
-			opengl_uniform(shader, "light_"+str(i)+"_pos", vec3({0,0,0}), false);
-			opengl_uniform(shader, "light_"+str(i)+"_color", vec3({0,0,0}), false);
-			opengl_uniform(shader, "light_"+str(i)+"_dist", 1.0f, false);
-			opengl_uniform(shader, "light_"+str(i)+"_intensity", 0.0f, false);
+	light_block_std140 block = {};
+	int const count = std::min(int(lights.size()), max_lights);
+	for (int i = 0; i < count; i++) {
+		block.lights[i].position = lights[i].position;
+		block.lights[i].distance = lights[i].distance;
+		block.lights[i].color = lights[i].color;
+		block.lights[i].intensity = lights[i].intensity;
+	}
+	block.light = light;
+	block.multilight = multiLight ? 1 : 0;
+	block.light_count = count;
+
+	// Lights reaching each cluster, so that a fragment only evaluates the ones near it
+	std::vector<vec3> centers(count);
+	std::vector<float> radii(count);
+	std::vector<float> intensities(count);
+	for (int i = 0; i < count; i++) {
+		centers[i] = lights[i].position;
+		radii[i] = lights[i].distance;
+		intensities[i] = lights[i].intensity;
+	}
+	clusters.build(centers, radii, intensities, camera_projection, camera_view);
+	clusters.upload(light_clusters_unit, light_indices_unit);
+	block.cluster_size[0] = light_clusters::size_x;
+	block.cluster_size[1] = light_clusters::size_y;
+	block.cluster_size[2] = light_clusters::size_z;
+	block.cluster_size[3] = light_clusters::index_width;
+	block.cluster_depth[0] = clusters.near();
+	block.cluster_depth[1] = clusters.scale();
+
+	if (light_block_buffer == 0) {
+		glGenBuffers(1, &light_block_buffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, light_block_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(block), &block, GL_DYNAMIC_DRAW);
+		glBindBufferBase(GL_UNIFORM_BUFFER, light_block_binding, light_block_buffer);
+	}
+	else {
+		glBindBuffer(GL_UNIFORM_BUFFER, light_block_buffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), &block);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void environment_structure::bind_lights(opengl_shader_structure const& shader)
+{
+	GLuint const index = glGetUniformBlockIndex(shader.id, "lights_block");
+	if (index != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader.id, index, light_block_binding);
+
+	GLint const clusters_location = glGetUniformLocation(shader.id, "light_clusters");
+	GLint const indices_location = glGetUniformLocation(shader.id, "light_indices");
+	if (clusters_location >= 0 || indices_location >= 0) {
+		glUseProgram(shader.id);
+		glUniform1i(clusters_location, light_clusters_unit);
+		glUniform1i(indices_location, light_indices_unit);
+		glUseProgram(0);
+	}
+}
+
+void environment_structure::draw(mesh_drawable const& drawable, int instance_count) const
+{
+	if (queue != NULL)
+		queue->push(drawable, instance_count, timings != NULL ? timings->current() : -1);
+	else
+		cgp::draw(drawable, *this, instance_count);
+}
+
+void environment_structure::draw(hierarchy_mesh_drawable const& hierarchy) const
+{
+	if (queue != NULL)
+		queue->push(hierarchy, timings != NULL ? timings->current() : -1);
+	else
+		cgp::draw(hierarchy, *this);
+}
+
+// Location of a uniform in a shader program, and the last value sent to it.
+// A program keeps its uniform values until they are set again, so a value identical to the last one is not resent.
+template <typename T>
+struct cached_uniform {
+	GLint location = -1;
+	bool sent = false;
+	T value;
+
+	void send(T const& new_value) {
+		if (location < 0 || (sent && std::memcmp(&value, &new_value, sizeof(T)) == 0))
+			return;
+		opengl_uniform(location, new_value);
+		value = new_value;
+		sent = true;
+	}
+};
+
+// Uniforms of the environment for one shader program, looked up the first time the program is drawn
+struct program_uniforms {
+	cached_uniform<mat4> projection;
+	cached_uniform<mat4> view;
+	cached_uniform<float> time;
+	cached_uniform<int> has_fog;
+	cached_uniform<float> fog_distance;
+	cached_uniform<vec3> fog_color;
+
+	std::map<std::string, cached_uniform<float>> generic_float;
+	std::map<std::string, cached_uniform<int>> generic_int;
+	std::map<std::string, cached_uniform<vec3>> generic_vec3;
+	std::map<std::string, cached_uniform<mat4>> generic_mat4;
+};
+
+static std::unordered_map<GLuint, program_uniforms> programs;
+
+static program_uniforms& get_program_uniforms(opengl_shader_structure const& shader, bool expected)
+{
+	auto found = programs.find(shader.id);
+	if (found != programs.end())
+		return found->second;
+
+	program_uniforms& uniforms = programs[shader.id];
+	uniforms.projection.location = glGetUniformLocation(shader.id, "projection");
+	uniforms.view.location = glGetUniformLocation(shader.id, "view");
+	uniforms.time.location = glGetUniformLocation(shader.id, "time");
+	uniforms.has_fog.location = glGetUniformLocation(shader.id, "has_fog");
+	uniforms.fog_distance.location = glGetUniformLocation(shader.id, "fog_distance");
+	uniforms.fog_color.location = glGetUniformLocation(shader.id, "fog_color");
+	if (expected && (uniforms.projection.location < 0 || uniforms.view.location < 0))
+		std::cout << "Warning: shader " << shader.id << " has no projection or view uniform" << std::endl;
+	return uniforms;
+}
+
+template <typename T>
+static void send_generic(GLuint program, std::map<std::string, cached_uniform<T>>& cache, std::map<std::string, T> const& values)
+{
+	for (auto const& entry : values) {
+		auto found = cache.find(entry.first);
+		if (found == cache.end()) {
+			found = cache.insert({ entry.first, cached_uniform<T>() }).first;
+			found->second.location = glGetUniformLocation(program, entry.first.c_str());
 		}
+		found->second.send(entry.second);
 	}
+}
+
+void environment_structure::send_opengl_uniform(opengl_shader_structure const& shader, bool expected) const
+{
+	// Camera, fog and time are the same for every draw of a frame: each program receives them once per frame
+	program_uniforms& uniforms = get_program_uniforms(shader, expected);
+	uniforms.projection.send(camera_projection);
+	uniforms.view.send(camera_view);
+	// (a "time" in uniform_generic replaces this one, as it is sent after)
+	if (uniform_generic.uniform_float.find("time") == uniform_generic.uniform_float.end())
+		uniforms.time.send(time);
+	uniforms.has_fog.send(has_fog ? 1 : 0);
+	uniforms.fog_distance.send(fog_distance);
+	uniforms.fog_color.send(fog_color);
 
-	uniform_generic.send_opengl_uniform(shader, false);
+	send_generic(shader.id, uniforms.generic_float, uniform_generic.uniform_float);
+	send_generic(shader.id, uniforms.generic_int, uniform_generic.uniform_int);
+	send_generic(shader.id, uniforms.generic_vec3, uniform_generic.uniform_vec3);
+	send_generic(shader.id, uniforms.generic_mat4, uniform_generic.uniform_mat4);
 
-}
\ No newline at end of file
+	// The other maps of uniform_generic are sent as before, without cache
+	uniform_generic_structure others = uniform_generic;
+	others.uniform_float.clear();
+	others.uniform_int.clear();
+	others.uniform_vec3.clear();
+	others.uniform_mat4.clear();
+	others.send_opengl_uniform(shader, false);
+}
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "cgp/cgp.hpp"
+#include "utils/frustum.hpp"
+#include "utils/render_queue.hpp"
+#include "utils/profiler.hpp"
 
 using namespace cgp;
 
@@ -30,13 +33,25 @@ struct environment_structure : environment_generic_structure
 	// A projection structure (perspective or orthogonal projection)
 	mat4 camera_projection;
 
+	// View volume of the camera for the current frame, the draws out of it are skipped
+	frustum view_frustum;
+
+	// When set, the draws of the objects are collected there and submitted sorted by state (see render_queue)
+	render_queue* queue = NULL;
+
+	// When set, the objects time their draws in its sections (see profiler)
+	profiler* timings = NULL;
+
 	// Use multiple lights
 	bool multiLight = false;
 	// The position of a light
 	vec3 light = {1,1,1};
 
-	const int max_lights = 8; // If you change this value, you must change it also in the shaders
+	static const int max_lights = 256; // If you change this value, you must change it also in the shaders
 	std::vector<light_params> lights;
+	static const GLuint light_block_binding = 0; // Binding point of the lights_block uniform block
+	static const int light_clusters_unit = 14; // Texture units of the light lists of the clusters (see light_clusters)
+	static const int light_indices_unit = 15;
 
 
 	bool has_fog = false;
@@ -50,9 +65,22 @@ struct environment_structure : environment_generic_structure
 
 
 	// This function will be called in the draw() call of a drawable element.
-	//  The function is expected to send the uniform variables to the shader (e.g. camera, light)
+	//  The function is expected to send the uniform variables to the shader (e.g. camera, fog)
+	//  The uniform locations are cached per shader program, and a value is only sent when it differs from the last one sent to the program
+	//  (uniform_generic: float, int, vec3 and mat4 uniforms, its other uniforms are sent every time)
 	void send_opengl_uniform(opengl_shader_structure const& shader, bool expected = true) const override;
 
+	// Upload light, multiLight and lights to the lights_block uniform block shared by every shader,
+	//  and the lights reaching each cluster of the view volume of camera_projection and camera_view (see light_clusters).
+	//  To call after changing them, before the draw calls using them (they are not sent by send_opengl_uniform)
+	void send_lights() const;
+	// Connect the lights_block and the cluster textures of the shader (if it has them) to the shared data, once after loading it
+	static void bind_lights(opengl_shader_structure const& shader);
+
+	// Draw now, or push to the queue when there is one
+	void draw(mesh_drawable const& drawable, int instance_count = 1) const;
+	void draw(hierarchy_mesh_drawable const& hierarchy) const;
+
 
 };
 
@@ -9,6 +9,7 @@
 
 // Custom scene of this code
 #include "scene.hpp"
+#include "utils/mesh_binary.hpp"
 
 
 
@@ -32,10 +33,18 @@ void display_gui_default();
 
 timer_fps fps_record;
 
-int main(int, char* argv[])
+int main(int argc, char* argv[])
 {
 	std::cout << "Run " << argv[0] << std::endl;
 
+	// Offline conversion of OBJ files to the binary mesh format (see scripts/convert_meshes.py)
+	if (argc > 1 && std::string(argv[1]) == "--convert-meshes") {
+		int failed = 0;
+		for (int k = 2; k < argc; ++k)
+			failed += mesh_binary::convert(argv[k]) ? 0 : 1;
+		return failed == 0 ? 0 : 1;
+	}
+
 	
 
 	// ************************ //
@@ -152,6 +161,10 @@ void initialize_default_shaders()
 	// Set standard mesh shader for mesh_drawable
 	mesh_drawable::default_shader.load(default_path_shaders +"mesh/mesh.vert.glsl", default_path_shaders +"mesh/mesh.frag.glsl");
 	triangles_drawable::default_shader.load(default_path_shaders +"mesh/mesh.vert.glsl", default_path_shaders +"mesh/mesh.frag.glsl");
+	environment_structure::bind_lights(mesh_drawable::default_shader);
+	environment_structure::bind_lights(triangles_drawable::default_shader);
+	render_queue::add_prepass_shader(mesh_drawable::default_shader);
+	render_queue::add_prepass_shader(triangles_drawable::default_shader);
 
 	// Set default white texture
 	image_structure const white_image = image_structure{ 1,1,image_color_type::rgba,{255,255,255,255} };
@@ -1,23 +1,39 @@
 #include "cave.hpp"
+#include "../utils/math.hpp"
 
 cave::cave()
 {
 
 }
 
+cave::~cave(){
+    CaveStream.stop();
+    if(cristal_partition!=NULL){
+        delete cristal_partition;
+    }
+}
+
+void cave::addAssets(asset_loader &loader){
+    cave_mesh::addAssets(loader);
+    cristal::addAssets(loader);
+}
+
 void cave::initialize(){
     if(partition==NULL){
         partition = new collision_partition({1.2,1.19,1.3});   
     }
+    if(cristal_partition==NULL){
+        cristal_partition = new collision_partition({1.2,1.19,1.3});
+    }
 
-    CaveMesh.initialize(partition);
+    CaveMesh.initialize(partition,&cave_arena);
     cristal1.initialize();
     cristal1.scaling = 0.7;
     cristal1.translation = {-5.373450,-4.367498,-1.732364};
     cristal1.rotation = rotation_transform::from_quaternion({0.069329,0.216544,0.324752,0.918062}),
     cristal1.distance = 10;
     cristal1.update();
-    cristal1.addCollisions(partition);
+    cristal1.addCollisions(cristal_partition,&arena);
 
 
     cristal2.initialize();
@@ -27,7 +43,7 @@ void cave::initialize(){
     cristal2.distance = 12;
     cristal2.intensity = 3;
     cristal2.update();
-    cristal2.addCollisions(partition);
+    cristal2.addCollisions(cristal_partition,&arena);
 
     cristal3.initialize();
     cristal3.translation = {6.399254,-1.817590,2.995139};
@@ -35,7 +51,7 @@ void cave::initialize(){
     cristal3.distance = 12;
     cristal3.intensity = 3;
     cristal3.update();
-    cristal3.addCollisions(partition);
+    cristal3.addCollisions(cristal_partition,&arena);
 
     cristal4.initialize();
     cristal4.scaling = 1.4;
@@ -44,7 +60,7 @@ void cave::initialize(){
     cristal4.distance = 12;
     cristal4.intensity = 3.5;
     cristal4.update();
-    cristal4.addCollisions(partition);
+    cristal4.addCollisions(cristal_partition,&arena);
 
     cristal5.initialize();
     cristal5.scaling = 1.25;
@@ -53,7 +69,7 @@ void cave::initialize(){
     cristal5.distance = 10;
     cristal5.intensity = 3;
     cristal5.update();
-    cristal5.addCollisions(partition);
+    cristal5.addCollisions(cristal_partition,&arena);
 
     cristal6.initialize();
     cristal6.scaling = 1.15;
@@ -62,7 +78,7 @@ void cave::initialize(){
     cristal6.distance = 10;
     cristal6.intensity = 3;
     cristal6.update();
-    cristal6.addCollisions(partition);
+    cristal6.addCollisions(cristal_partition,&arena);
 
     cristal7.initialize();
     cristal7.scaling = 1.23;
@@ -71,13 +87,33 @@ void cave::initialize(){
     cristal7.distance = 12;
     cristal7.intensity = 3.8;
     cristal7.update();
-    cristal7.addCollisions(partition);
+    cristal7.addCollisions(cristal_partition,&arena);
+
+    cristals.clear();
+    cristals.add(cristal1);
+    cristals.add(cristal2);
+    cristals.add(cristal3);
+    cristals.add(cristal4);
+    cristals.add(cristal5);
+    cristals.add(cristal6);
+    cristals.add(cristal7);
 
 
     collision_handler::initialize(partition);
+    cristal_collisions.initialize(cristal_partition);
 }
 
-void cave::draw(environment_structure &environment){
+void cave::update(vec3 const& position){
+    if(streamed && !CaveStream.is_running()){
+        CaveStream.start();
+    }
+    else if(!streamed && CaveStream.is_running()){
+        CaveStream.stop();
+    }
+    CaveStream.update(position);
+}
+
+void cave::add_lights(environment_structure &environment){
     environment.multiLight = true;
     environment.lights.push_back(cristal1.getLightParams());
     environment.lights.push_back(cristal2.getLightParams());
@@ -90,12 +126,82 @@ void cave::draw(environment_structure &environment){
     environment.lights.push_back(cristal5_light);
     environment.lights.push_back(cristal6.getLightParams());
     environment.lights.push_back(cristal7.getLightParams());
-    CaveMesh.draw(environment);
-    cristal1.draw(environment);
-    cristal2.draw(environment);
-    cristal3.draw(environment);
-    cristal4.draw(environment);
-    cristal5.draw(environment);
-    cristal6.draw(environment);
-    cristal7.draw(environment);
+}
+
+void cave::draw(environment_structure &environment){
+    view_position = math::camera_position(environment.camera_view);
+    view_direction = -vec3{environment.camera_view(2,0),environment.camera_view(2,1),environment.camera_view(2,2)};
+
+    {
+        profiler::scope section(environment.timings, "cave");
+        if(streamed){
+            CaveStream.draw(environment);
+        }
+        else{
+            CaveMesh.draw(environment);
+        }
+    }
+    profiler::scope section(environment.timings, "crystals");
+    cristals.draw(environment);
+}
+
+void cave::display_gui(){
+    ImGui::Checkbox("Endless cave", &streamed);
+    if(streamed){
+        ImGui::Text("Cave chunks: %d loaded, %d in generation", CaveStream.loaded_chunks(), CaveStream.pending_chunks());
+    }
+    else{
+        ImGui::Checkbox("Terrain editing", &editing);
+        if(CaveMesh.compressed_collisions){
+            ImGui::Text("Cave collisions: %d triangles, %d KB", CaveMesh.collision_triangles, int(CaveMesh.collision_memory/1024));
+        }
+        ImGui::Text("Collision deviation: %.4f", CaveMesh.collision_max_error);
+    }
+    if(editing && !streamed){
+        CaveMesh.display_gui();
+        ImGui::SliderFloat("Brush radius", &brush_radius, 0.2f, 3.0f);
+        ImGui::SliderFloat("Brush strength", &brush_strength, 0.005f, 0.1f);
+        // The brush is applied at each frame while a button is held
+        ImGui::Button("Raise");
+        bool const raise = ImGui::IsItemActive();
+        ImGui::Button("Dig");
+        bool const dig = ImGui::IsItemActive();
+        if(raise || dig){
+            collision_ray ray(view_position, 30*view_direction);
+            vec3 target;
+            if(collision_handler::does_collide(&ray, target)){
+                CaveMesh.brush(target, brush_radius, raise ? brush_strength : -brush_strength);
+            }
+        }
+        ImGui::Text("Last edit: %.2f ms", CaveMesh.last_edit_time);
+    }
+    ImGui::Checkbox("Cave levels of detail", &cave_mesh::use_lod);
+    int const drawn = streamed ? CaveStream.drawn_triangles() : CaveMesh.drawn_triangles();
+    int const full = streamed ? CaveStream.full_triangles() : CaveMesh.full_triangles();
+    ImGui::Text("Cave triangles: %d drawn / %d", drawn, full);
+}
+
+bool cave::does_collide(collision_object* col2, vec3 &collision_point){
+    bool found;
+    vec3 result;
+    if(streamed){
+        found = CaveStream.does_collide(col2, result);
+    }
+    else{
+        found = collision_handler::does_collide(col2, result);
+    }
+
+    // Keep the closest hit between the cave and the crystals
+    vec3 cristal_point;
+    if(cristal_collisions.does_collide(col2, cristal_point)){
+        collision_ray* ray = dynamic_cast<collision_ray*>(col2);
+        if(!found || (ray!=nullptr && norm(cristal_point-ray->translation)<norm(result-ray->translation))){
+            result = cristal_point;
+            found = true;
+        }
+    }
+    if(found){
+        collision_point = result;
+    }
+    return found;
 }
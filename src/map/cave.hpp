@@ -3,12 +3,20 @@
 
 #include "../environment.hpp"
 #include "cave_mesh.hpp"
+#include "cave_stream.hpp"
 #include "cristal.hpp"
 
 class cave: public collision_handler
 {
 private:
+    collision_arena arena; // owns the static collision primitives of the crystals
+    collision_arena cave_arena; // owns the collisions of CaveMesh, cleared when its terrain is edited
     cave_mesh CaveMesh;
+    cave_stream CaveStream; // endless version of the cave, replaces CaveMesh when streamed is set
+
+    // The crystals have their own partition so that they stay collidable whichever cave is used
+    collision_partition *cristal_partition = NULL;
+    collision_handler cristal_collisions;
 
     cristal_rock cristal1;
     cristal_ram cristal2;
@@ -17,12 +25,32 @@ private:
     cristal_ram_gold cristal5;
     cristal_rock_gold cristal6;
     cristal_large cristal7;
+    cristal_renderer cristals; // draws the crystals above, one draw per crystal mesh
+
+    // Camera of the last draw, the brush is applied where its view direction hits the cave
+    vec3 view_position;
+    vec3 view_direction;
 public:
     cave();
+    ~cave();
+
+    bool streamed = false;
 
+    bool editing = false; // Terrain editing mode: noise sliders and brush
+    float brush_radius = 1.0f;
+    float brush_strength = 0.02f; // Noise offset added at the brush center at each frame
+
+    static void addAssets(asset_loader &loader); // Files loaded by initialize()
     void initialize();
+    void update(vec3 const& position); // Follows position with the streamed cave
 
+    // Lights of the crystals, to be sent with environment.send_lights() before draw()
+    void add_lights(environment_structure &environment);
     void draw(environment_structure &environment);
+    void display_gui();
+
+    using collision_handler::does_collide;
+    bool does_collide(collision_object* col2, vec3 &collision_point) override;
 };
 
 #endif // CAVE_H
@@ -1,5 +1,15 @@
 #include "cave_mesh.hpp"
 #include "../utils/math.hpp"
+#include "../utils/parallel.hpp"
+#include "../utils/fractal_noise.hpp"
+#include "../utils/tangent_space.hpp"
+#include "../utils/gpu_buffer.hpp"
+#include "../utils/binary_cache.hpp"
+#include "../utils/asset_registry.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
 
 cave_mesh::cave_mesh()
@@ -11,46 +21,78 @@ bool cave_mesh::initialized_textures = false;
 opengl_texture_image_structure cave_mesh::texture;
 opengl_texture_image_structure cave_mesh::normal_map_texture;
 opengl_shader_structure cave_mesh::shader;
+bool cave_mesh::use_lod = true;
 
 void cave_mesh::initialize(){
-    cmesh_ground = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},terrain_sample,terrain_sample);
-    cmesh = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},arch_sample,arch_sample);
-    cmesh_wall1 = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},wall_sample,wall_sample);
-    cmesh_wall2 = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},wall_sample,wall_sample);
-    cmeshd.initialize_data_on_gpu(cmesh);
-    cmeshd_ground.initialize_data_on_gpu(cmesh_ground);
-    cmeshd_wall1.initialize_data_on_gpu(cmesh_wall1);
-    cmeshd_wall2.initialize_data_on_gpu(cmesh_wall2);
+    generate();
+    upload();
+}
+
+float cave_mesh::segment_length(float scaling, float length)
+{
+    return 20*scaling*length;
+}
+
+void cave_mesh::place_surfaces(){
+    float const offset = chunk*segment_length();
     cmeshd.model.scaling = 10 * scaling;
-    cmeshd.model.translation = {0,0,scaling * 4.5/2};
+    cmeshd.model.translation = {0,offset,scaling * 4.5/2};
     cmeshd.model.scaling_xyz = {1,length,1};
     cmeshd_ground.model.scaling = 10 * scaling;
-    cmeshd_ground.model.translation = {0,0,scaling * (-11-r)/2};
+    cmeshd_ground.model.translation = {0,offset,scaling * (-11-r)/2};
     cmeshd_ground.model.scaling_xyz = {1,length,1};
     
     cmeshd_wall1.model.scaling = 10 * scaling;
-    cmeshd_wall1.model.translation = {0,0,scaling * 4.5/2};
+    cmeshd_wall1.model.translation = {0,offset,scaling * 4.5/2};
     cmeshd_wall1.model.scaling_xyz = {1,length,1};
     cmeshd_wall2.model.scaling = 10 * scaling;
-    cmeshd_wall2.model.translation = {0,0,scaling * 4.5/2};
+    cmeshd_wall2.model.translation = {0,offset,scaling * 4.5/2};
     cmeshd_wall2.model.scaling_xyz = {1,length,1};
+}
+
+void cave_mesh::generate(){
+    cmesh_ground = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},terrain_sample,terrain_sample);
+    cmesh = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},arch_sample,arch_sample);
+    if(closed_ends){
+        cmesh_wall1 = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},wall_sample,wall_sample);
+        cmesh_wall2 = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},wall_sample,wall_sample);
+    }
+    place_surfaces();
 
 
     if(partition==NULL){
-        partition = new collision_partition({1.2,1.2,1.3});   
+        // The partition follows the chunk along the tunnel axis
+        partition = new collision_partition({1.2,1.2,1.3},{0,chunk*segment_length(),0});
+    }
+    if(arena==NULL){
+        arena = new collision_arena();
     }
     collision_handler::initialize(partition);
 
 
     //cmeshd_ground.model.rotation = rotation_axis_angle({1,0,0},-Pi/2);
-    update_terrain();
+    compute_terrain();
+}
+
+void cave_mesh::upload(){
+    // The model transforms are set again as the initialization of the drawables resets them
+    cmeshd.initialize_data_on_gpu(cmesh);
+    cmeshd_ground.initialize_data_on_gpu(cmesh_ground);
+    if(closed_ends){
+        cmeshd_wall1.initialize_data_on_gpu(cmesh_wall1);
+        cmeshd_wall2.initialize_data_on_gpu(cmesh_wall2);
+    }
+    place_surfaces();
+    upload_tangents();
 
     if(!initialized_textures){
-        texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_comp.png",
+        texture = asset_registry::get_texture(project::path + "assets/rock_face_comp.png",
             GL_REPEAT,
             GL_REPEAT);
-        normal_map_texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_normal_comp.png");
+        normal_map_texture = asset_registry::get_texture(project::path + "assets/rock_face_normal_comp.png");
         shader.load(project::path + "shaders/normal_map/mesh_normal.vert.glsl", project::path + "shaders/normal_map/mesh_normal.frag.glsl");
+        environment_structure::bind_lights(shader);
+        render_queue::add_prepass_shader(shader);
         initialized_textures = true;
     }
 
@@ -85,352 +127,778 @@ void cave_mesh::initialize(){
     cmeshd_wall2.material = cmeshd.material;
 }
 
+void cave_mesh::clear(){
+    cmeshd.clear();
+    cmeshd_ground.clear();
+    if(closed_ends){
+        cmeshd_wall1.clear();
+        cmeshd_wall2.clear();
+    }
+}
+
 void cave_mesh::initialize(collision_partition *_partition){
     partition = _partition;
     createdPartition = false;
     initialize();
 }
 
+void cave_mesh::initialize(collision_partition *_partition, collision_arena *_arena){
+    arena = _arena;
+    createdArena = false;
+    initialize(_partition);
+}
+
 cave_mesh::~cave_mesh(){
     if(createdPartition){
         delete partition;
     }
-    for(auto object : toDelete){
-        delete object;
+    if(createdArena){
+        delete arena;
     }
 }
 
 
-void cave_mesh::draw(environment_structure environment){
-    cgp::draw(cmeshd,environment);
-    cgp::draw(cmeshd_ground,environment);
-    cgp::draw(cmeshd_wall1,environment);
-    cgp::draw(cmeshd_wall2,environment);
+void cave_mesh::draw(environment_structure const& environment){
+    // Everything is at full resolution up to the fog distance, or everywhere when the levels of detail are disabled
+    vec3 const camera = math::camera_position(environment.camera_view);
+    float const distance = (use_lod && environment.has_fog) ? environment.fog_distance : std::numeric_limits<float>::max();
+    lod.lod_distance = lod_ground.lod_distance = lod_wall1.lod_distance = lod_wall2.lod_distance = distance;
+
+    // The tiles out of view are removed from the index buffers, a surface without any visible tile is not drawn
+    frustum const* view = &environment.view_frustum;
+    lod.update(cmeshd,camera,view);
+    lod_ground.update(cmeshd_ground,camera,view);
+    if(cmeshd.ebo_connectivity.size>0){environment.draw(cmeshd);}
+    if(cmeshd_ground.ebo_connectivity.size>0){environment.draw(cmeshd_ground);}
+    if(closed_ends){
+        lod_wall1.update(cmeshd_wall1,camera,view);
+        lod_wall2.update(cmeshd_wall2,camera,view);
+        if(cmeshd_wall1.ebo_connectivity.size>0){environment.draw(cmeshd_wall1);}
+        if(cmeshd_wall2.ebo_connectivity.size>0){environment.draw(cmeshd_wall2);}
+    }
 }
 
-void cave_mesh::update_terrain()
-{
-    // Number of samples in each direction (assuming a square grid)
-    int const N = std::sqrt(cmesh.position.size());
-    int const N_ground = std::sqrt(cmesh_ground.position.size());
-    int const N_wall = std::sqrt(cmesh_wall1.position.size());
-    numarray<vec3> tangents;
-    numarray<vec3> bitangents;
-
-
-    numarray<vec3> tangents_ground;
-    numarray<vec3> bitangents_ground;
-
-    numarray<vec3> tangents_wall1;
-    numarray<vec3> bitangents_wall1;
-    numarray<vec3> tangents_wall2;
-    numarray<vec3> bitangents_wall2;
+int cave_mesh::drawn_triangles(){
+    return lod.get_drawn_triangles()+lod_ground.get_drawn_triangles()+lod_wall1.get_drawn_triangles()+lod_wall2.get_drawn_triangles();
+}
 
-    // Recompute the new vertices
-    for (int ku = 0; ku < N; ++ku) {
-        for (int kv = 0; kv < N; ++kv) {
+int cave_mesh::full_triangles(){
+    return lod.get_full_triangles()+lod_ground.get_full_triangles()+lod_wall1.get_full_triangles()+lod_wall2.get_full_triangles();
+}
 
-            // Compute local parametric coordinates (u,v) \in [0,1]
-            const float u = ku/(N-1.0f);
-            const float v = kv/(N-1.0f);
+void cave_mesh::display_gui(){
+    // The render surfaces follow the sliders while they are dragged, the collisions are rebuilt once a slider is released
+    bool arch = false;
+    bool ground = false;
+    bool settled = false;
+    arch |= ImGui::SliderInt("Cave octave", &octave, 1, 10);
+    settled |= ImGui::IsItemDeactivatedAfterEdit();
+    arch |= ImGui::SliderFloat("Cave persistency", &persistency, 0.1f, 0.9f);
+    settled |= ImGui::IsItemDeactivatedAfterEdit();
+    arch |= ImGui::SliderFloat("Cave height", &terrain_height, 0.0f, 1.0f);
+    settled |= ImGui::IsItemDeactivatedAfterEdit();
+    ground |= ImGui::SliderInt("Ground octave", &octave_ground, 1, 10);
+    settled |= ImGui::IsItemDeactivatedAfterEdit();
+    ground |= ImGui::SliderFloat("Ground persistency", &persistency_ground, 0.1f, 0.9f);
+    settled |= ImGui::IsItemDeactivatedAfterEdit();
+    ground |= ImGui::SliderFloat("Ground height", &terrain_height_ground, 0.0f, 1.0f);
+    settled |= ImGui::IsItemDeactivatedAfterEdit();
+
+    if(arch || ground){
+        update_terrain(arch,ground);
+    }
+    if(settled){
+        update_collisions();
+    }
 
-            int const idx = ku*N+kv;
+    // Reproducible timing of tangent_space::compute on the arch, averaged over a few runs
+    if(ImGui::Button("Time tangent frames")){
+        int const runs = 10;
+        auto const start = std::chrono::steady_clock::now();
+        for(int k=0;k<runs;k++){
+            tangent_space::compute(cmesh,tangents,bitangents);
+        }
+        tangent_time = std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now()-start).count()/runs;
+    }
+    if(tangent_time>0){
+        ImGui::SameLine();
+        ImGui::Text("%.2f ms for %d vertices, %d threads", tangent_time, int(cmesh.position.size()), parallel::thread_count());
+    }
+}
 
-            // Compute the Perlin noise
-            float const noise = noise_perlin({u, length*v/2}, octave, persistency, frequency_gain);
+vec2 cave_mesh::noise_coordinates(cave_surface surface, float u, float v) const
+{
+    // The noise continues from one chunk to the next along the tunnel axis
+    if(surface==GroundSurface){
+        return {u, length*v + chunk*length};
+    }
+    if(surface==Wall2Surface){
+        return {u+1, length*v/2+1};
+    }
+    if(surface==Wall1Surface){
+        return {u, length*v/2};
+    }
+    return {u, length*v/2 + chunk*length/2};
+}
 
-            // use the noise as height value
-            float dr = terrain_height*noise;
+void cave_mesh::surface_noise(cave_surface surface, numarray<vec2> const& coordinates, numarray<float> &noise) const
+{
+    if(surface==GroundSurface){
+        fractal_noise::perlin(coordinates, noise, octave_ground, persistency_ground, frequency_gain_ground);
+    }
+    else{
+        fractal_noise::perlin(coordinates, noise, octave, persistency, frequency_gain);
+    }
+}
 
-            cmesh.position[idx].z = scaling*def_r*r*(1+dr)*sin(1.4*Pi*u-0.2*Pi);
-            cmesh.position[idx].x = scaling*r*(1+dr)*cos(1.4*Pi*u-0.2*Pi);
+vec3 cave_mesh::surface_position(cave_surface surface, float u, float v) const
+{
+    vec2 const p = noise_coordinates(surface,u,v);
+    if(surface==GroundSurface){
+        return surface_position(surface,u,v,fractal_noise::perlin(p, octave_ground, persistency_ground, frequency_gain_ground));
+    }
+    return surface_position(surface,u,v,fractal_noise::perlin(p, octave, persistency, frequency_gain));
+}
 
-            tangents.push_back({0,1,0});
-            bitangents.push_back({1,0,0});
+vec3 cave_mesh::surface_position(cave_surface surface, float u, float v, float noise, float relief) const
+{
+    if(surface==ArchSurface){
+        // use the noise as height value
+        float dr = terrain_height*noise + relief;
 
-            // use also the noise as color value
-            //cmesh.color[idx] = vec3(0,0.5f,0)*0.3f+0.7f*noise*vec3(1,1,1);
-        }
+        return {scaling*r*(1+dr)*cos(1.4*Pi*u-0.2*Pi), 2*v-1, scaling*def_r*r*(1+dr)*sin(1.4*Pi*u-0.2*Pi)};
+    }
+    if(surface==GroundSurface){
+        // use the noise as height value
+        float dr = terrain_height_ground*noise + relief;
+        return {2*u-1, 2*v-1, dr + pow(u-0.5,2)/r};
     }
-    // Do the same for the walls
-    for (int ku = 0; ku < N_wall; ++ku) {
-        for (int kv = 0; kv < N_wall; ++kv) {
-            // Compute local parametric coordinates (u,v) \in [0,1]
-            const float u = ku/(N_wall-1.0f);
-            const float v = kv/(N_wall-1.0f);
 
-            int const idx = ku*N_wall+kv;
+    // Walls closing both ends of the cave
+    float x=u,y=v,offsetz;
+    float multx=1,multz=1;
+    if(u<0.5){multx = -1;}
+    if(v<0.5){multz = -1;}
+    multx *= 1.05;
+    multz *= 1.07;
 
-            // Compute the Perlin noise
-            float const noise = noise_perlin({u, length*v/2}, octave, persistency, frequency_gain);
-            float const noise2 = noise_perlin({u+1, length*v/2+1}, octave, persistency, frequency_gain);
+    offsetz = 0.17;
 
-            // use the noise as height value
-            float dr = 0.3*terrain_height*noise;
-            float dr2 = 0.3*terrain_height*noise2;
+    x = x-0.5;
+    y = y-0.5;
 
-            float x=u,y=v,offset,offset2,offsetz;
-            float multx=1,multz=1;
-            if(u<0.5){multx = -1;}
-            if(v<0.5){multz = -1;}
-            multx *= 1.05;
-            multz *= 1.07;
+    float norm = sqrt(x*x+y*y);
 
-            offset = +1.22;
-            offset2 = 1.22;
-            offsetz = 0.17;
+    float size_mult = 0.70;
 
-            x = x-0.5;
-            y = y-0.5;
+    if(surface==Wall1Surface){
+        float dr = 0.3*terrain_height*noise + relief;
+        float offset = +1.22;
+        return {multx*size_mult*(log(fabs(u-0.5)+0.3)+1.2039), offset+dr-1.35*norm, offsetz + multz*size_mult*(log(fabs(v-0.5)+0.3)+1.2039)};
+    }
+    float dr2 = 0.3*terrain_height*noise + relief;
+    float offset2 = 1.22;
+    return {-multx*size_mult*(log(fabs(u-0.5)+0.3)+1.2039), -(offset2+dr2-1.35*norm), offsetz -0.03 + multz*size_mult*(log(fabs(v-0.5)+0.3)+1.2039)};
+}
 
-            float norm = sqrt(x*x+y*y);
+void cave_mesh::fill_surface(cgp::mesh &surface, cave_surface which, int first_row, int row_count)
+{
+    // Number of samples in each direction (assuming a square grid)
+    int const N = std::sqrt(surface.position.size());
+    if(row_count<0){row_count = N-first_row;}
+    // Rows are independent: each one is computed by a single thread
+    parallel::parallel_for(first_row, first_row+row_count, [&](int ku){
+        // The noise of a whole row is evaluated at once by the vectorised implementation
+        numarray<vec2> coordinates(N);
+        numarray<float> noise(N);
+        for (int kv = 0; kv < N; ++kv) {
+            // Compute local parametric coordinates (u,v) \in [0,1]
+            coordinates[kv] = noise_coordinates(which, ku/(N-1.0f), kv/(N-1.0f));
+        }
+        surface_noise(which,coordinates,noise);
+        for (int kv = 0; kv < N; ++kv) {
+            const float u = ku/(N-1.0f);
+            const float v = kv/(N-1.0f);
+            surface.position[ku*N+kv] = surface_position(which,u,v,noise[kv],relief_at(which,u,v));
+        }
+    });
+}
 
-            float size_mult = 0.70;
+cgp::mesh const& cave_mesh::collision_source(cave_surface which)
+{
+    surface_buffers surface = get_surface(which);
+    int const N = std::sqrt(surface.shape.position.size());
+    int const N_collision = get_collision_sample(which);
+    if(N_collision<=1 || N_collision>=N){
+        return surface.shape;
+    }
+    if(surface.collision.position.size()!=N_collision*N_collision){
+        surface.collision = mesh_primitive_grid({-1,-1,0},{1,-1,0},{1,1,0},{-1,1,0},N_collision,N_collision);
+    }
+    return surface.collision;
+}
 
-            cmesh_wall1.position[idx].x = multx*size_mult*(log(fabs(u-0.5)+0.3)+1.2039);
-            cmesh_wall1.position[idx].y = offset+dr-1.35*norm;
-            cmesh_wall1.position[idx].z = offsetz + multz*size_mult*(log(fabs(v-0.5)+0.3)+1.2039);
-            
-            cmesh_wall2.position[idx].x = -multx*size_mult*(log(fabs(u-0.5)+0.3)+1.2039);
-            cmesh_wall2.position[idx].y = -(offset2+dr2-1.35*norm);
-            cmesh_wall2.position[idx].z = offsetz -0.03 + multz*size_mult*(log(fabs(v-0.5)+0.3)+1.2039);
+void cave_mesh::update_collision_surface(cave_surface which)
+{
+    surface_buffers surface = get_surface(which);
+    row_error[which].clear();
+    if(&collision_source(which)!=&surface.collision){
+        return;
+    }
+    fill_surface(surface.collision,which);
+    int const N = std::sqrt(surface.shape.position.size());
+    update_collision_error(which,0,N-1);
+}
 
-            tangents_wall1.push_back({0,1,0});
-            bitangents_wall1.push_back({1,0,0});
-            tangents_wall2.push_back({0,1,0});
-            bitangents_wall2.push_back({1,0,0});
-        }
+// True when the quads of the grid are split along their (00,11) diagonal, read from the first triangle
+static bool split_along_00_11(mesh const& grid, int N)
+{
+    if(grid.connectivity.size()==0){return true;}
+    uint3 const& t = grid.connectivity[0];
+    bool has_00 = false, has_11 = false;
+    for(int c=0;c<3;c++){
+        has_00 = has_00 || t[c]==0;
+        has_11 = has_11 || int(t[c])==N+1;
     }
+    return has_00 && has_11;
+}
 
+void cave_mesh::update_collision_error(cave_surface which, int first_row, int last_row)
+{
+    surface_buffers surface = get_surface(which);
+    mesh const& collision = surface.collision;
+    mesh const& render = surface.shape;
+    int const N = std::sqrt(render.position.size());
+    int const N_collision = std::sqrt(collision.position.size());
+    std::vector<float> &errors = row_error[which];
+    if(int(errors.size())!=N){
+        errors.assign(N,0.0f);
+        first_row = 0;
+        last_row = N-1;
+    }
+    first_row = std::max(first_row,0);
+    last_row = std::min(last_row,N-1);
+
+    // Deviation of the render vertices from the collision triangles, interpolated at the same (u,v)
+    // on the triangle of the quad containing it, split as the collision grid
+    bool const diagonal_00_11 = split_along_00_11(collision,N_collision);
+    vec3 const world_scaling = surface.drawable.model.scaling*surface.drawable.model.scaling_xyz;
+    parallel::parallel_for(first_row, last_row+1, [&](int ku){
+        errors[ku] = 0;
+        for (int kv = 0; kv < N; ++kv) {
+            float const cu = ku/(N-1.0f)*(N_collision-1);
+            float const cv = kv/(N-1.0f)*(N_collision-1);
+            int const iu = std::min(int(cu),N_collision-2);
+            int const iv = std::min(int(cv),N_collision-2);
+            float const tu = cu-iu;
+            float const tv = cv-iv;
+            vec3 const& p00 = collision.position[iu*N_collision+iv];
+            vec3 const& p01 = collision.position[iu*N_collision+iv+1];
+            vec3 const& p10 = collision.position[(iu+1)*N_collision+iv];
+            vec3 const& p11 = collision.position[(iu+1)*N_collision+iv+1];
+            vec3 p;
+            if(diagonal_00_11){
+                p = (tu>=tv) ? p00 + tu*(p10-p00) + tv*(p11-p10) : p00 + tv*(p01-p00) + tu*(p11-p01);
+            }
+            else{
+                p = (tu+tv<=1) ? p00 + tu*(p10-p00) + tv*(p01-p00) : p11 + (1-tu)*(p01-p11) + (1-tv)*(p10-p11);
+            }
+            float const error = norm(world_scaling*(render.position[ku*N+kv]-p));
+            errors[ku] = std::max(errors[ku],error);
+        }
+    });
 
-    // Do the same for ground
-    for (int ku = 0; ku < N_ground; ++ku) {
-        for (int kv = 0; kv < N_ground; ++kv) {
-            const float u = ku/(N_ground-1.0f);
-            const float v = kv/(N_ground-1.0f);
+    surface_error[which] = *std::max_element(errors.begin(), errors.end());
+    collision_max_error = *std::max_element(surface_error, surface_error+4);
+}
 
-            int const idx = ku*N_ground+kv;
+int cave_mesh::get_collision_sample(cave_surface which)
+{
+    if(which==ArchSurface){return collision_arch_sample;}
+    if(which==GroundSurface){return collision_terrain_sample;}
+    return collision_wall_sample;
+}
 
-            float const noise = noise_perlin({u, length*v}, octave_ground, persistency_ground, frequency_gain_ground);
+void cave_mesh::add_collisions(cave_surface which, cgp::mesh const& surface, cgp::mesh_drawable const& surfaced)
+{
+    surface_collisions &c = collisions[which];
+    c.source = &surface;
+    c.tiles.clear();
+    c.whole = NULL;
+
+    if(!compressed_collisions){
+        // The collision geometry directly references the vertex buffer and the connectivity of the mesh
+        c.whole = arena->create<collision_mesh>(partition,&surface);
+        c.whole->scaling = surfaced.model.scaling;
+        c.whole->scaling_xyz = surfaced.model.scaling_xyz;
+        c.whole->translation = surfaced.model.translation;
+        c.whole->build();
+        partition->add_collision(c.whole);
+        return;
+    }
 
-            // use the noise as height value
-            float dr = terrain_height_ground*noise;
-            cmesh_ground.position[idx].z = dr+0*pow(u-0.5,2) + pow(u-0.5,2)/r;
-            //cmesh_ground.position[idx].z = 0;
-            tangents_ground.push_back({0,1,0});
-            bitangents_ground.push_back({1,0,0});
+    // Each triangle goes to the tile of its quad (smallest row and column of its vertices)
+    int const N = std::sqrt(surface.position.size());
+    if(N<2){return;}
+    int const tiles = std::min(collision_tiles, N-1);
+    for(int tu=0;tu<tiles;tu++){
+        for(int tv=0;tv<tiles;tv++){
+            collision_tile tile;
+            tile.u0 = tu*(N-1)/tiles;
+            tile.u1 = (tu+1)*(N-1)/tiles;
+            tile.v0 = tv*(N-1)/tiles;
+            tile.v1 = (tv+1)*(N-1)/tiles;
+            c.tiles.push_back(tile);
         }
     }
-    for (int ku = 0; ku < N_wall-1; ++ku) {
-        for (int kv = 0; kv < N_wall-1; ++kv) {
-            int const idx = ku*N_wall+kv;
-            int const idx2 = ku*N_wall+kv+1;
-            int const idx3 = (ku+1)*N_wall+kv;
-            int const idx4 = (ku+1)*N_wall+kv+1;
-
-            vec3 pos1 = cmeshd_wall1.model.scaling*cmeshd_wall1.model.scaling_xyz*cmesh_wall1.position[idx]+cmeshd_wall1.model.translation;
-            vec3 pos2 = cmeshd_wall1.model.scaling*cmeshd_wall1.model.scaling_xyz*cmesh_wall1.position[idx2]+cmeshd_wall1.model.translation;
-            vec3 pos3 = cmeshd_wall1.model.scaling*cmeshd_wall1.model.scaling_xyz*cmesh_wall1.position[idx3]+cmeshd_wall1.model.translation;
-            vec3 pos4 = cmeshd_wall1.model.scaling*cmeshd_wall1.model.scaling_xyz*cmesh_wall1.position[idx4]+cmeshd_wall1.model.translation;
-
-            collision_object* tri1 = new collision_triangle(pos1,pos2-pos1,pos4-pos1);
-            collision_object* tri2 = new collision_triangle(pos1,pos3-pos1,pos4-pos1);
-            toDelete.push_back(tri1);
-            toDelete.push_back(tri2);
-            partition->add_collision(tri1);
-            partition->add_collision(tri2);
-
-            pos1 = cmeshd_wall2.model.scaling*cmeshd_wall2.model.scaling_xyz*cmesh_wall2.position[idx]+cmeshd_wall2.model.translation;
-            pos2 = cmeshd_wall2.model.scaling*cmeshd_wall2.model.scaling_xyz*cmesh_wall2.position[idx2]+cmeshd_wall2.model.translation;
-            pos3 = cmeshd_wall2.model.scaling*cmeshd_wall2.model.scaling_xyz*cmesh_wall2.position[idx3]+cmeshd_wall2.model.translation;
-            pos4 = cmeshd_wall2.model.scaling*cmeshd_wall2.model.scaling_xyz*cmesh_wall2.position[idx4]+cmeshd_wall2.model.translation;
-
-            tri1 = new collision_triangle(pos1,pos2-pos1,pos4-pos1);
-            tri2 = new collision_triangle(pos1,pos3-pos1,pos4-pos1);
-            toDelete.push_back(tri1);
-            toDelete.push_back(tri2);
-            partition->add_collision(tri1);
-            partition->add_collision(tri2);
-        }
+    for(uint3 const& triangle : surface.connectivity){
+        int const ku = std::min(std::min(triangle[0]/N,triangle[1]/N),triangle[2]/N);
+        int const kv = std::min(std::min(triangle[0]%N,triangle[1]%N),triangle[2]%N);
+        int const tu = std::min(ku*tiles/(N-1),tiles-1);
+        int const tv = std::min(kv*tiles/(N-1),tiles-1);
+        c.tiles[tu*tiles+tv].triangles.push_back(triangle);
+    }
+
+    numarray<vec3> world;
+    world_positions(which,world);
+    for(collision_tile &tile : c.tiles){
+        tile.object = arena->create<collision_compressed_mesh>(partition);
+        fill_tile(tile,world);
+        partition->add_collision(tile.object);
     }
+}
 
-    for (int ku = 0; ku < N-1; ++ku) {
-        for (int kv = 0; kv < N-1; ++kv) {
+void cave_mesh::world_positions(cave_surface which, numarray<vec3> &world, int ku0, int ku1, int kv0, int kv1)
+{
+    surface_collisions const& c = collisions[which];
+    affine_rts const& model = get_surface(which).drawable.model;
+    int const N = std::sqrt(c.source->position.size());
+    if(ku1<0){ku1 = N-1;}
+    if(kv1<0){kv1 = N-1;}
+    world.resize(c.source->position.size());
+    parallel::parallel_for(ku0, ku1+1, [&](int ku){
+        for(int kv=kv0;kv<=kv1;kv++){
             int const idx = ku*N+kv;
-            int const idx2 = ku*N+kv+1;
-            int const idx3 = (ku+1)*N+kv;
-            int const idx4 = (ku+1)*N+kv+1;
-
-            vec3 pos1 = cmeshd.model.scaling*cmeshd.model.scaling_xyz*cmesh.position[idx]+cmeshd.model.translation;
-            vec3 pos2 = cmeshd.model.scaling*cmeshd.model.scaling_xyz*cmesh.position[idx2]+cmeshd.model.translation;
-            vec3 pos3 = cmeshd.model.scaling*cmeshd.model.scaling_xyz*cmesh.position[idx3]+cmeshd.model.translation;
-            vec3 pos4 = cmeshd.model.scaling*cmeshd.model.scaling_xyz*cmesh.position[idx4]+cmeshd.model.translation;
-
-            collision_object* tri1 = new collision_triangle(pos1,pos2-pos1,pos4-pos1);
-            collision_object* tri2 = new collision_triangle(pos1,pos3-pos1,pos4-pos1);
-            toDelete.push_back(tri1);
-            toDelete.push_back(tri2);
-            partition->add_collision(tri1);
-            partition->add_collision(tri2);
+            world[idx] = model.translation + model.scaling*(model.rotation*(model.scaling_xyz*c.source->position[idx]));
+        }
+    }, std::max(4096/N,1));
+}
+
+void cave_mesh::fill_tile(collision_tile &tile, numarray<vec3> const& world)
+{
+    tile.object->clear();
+    tile.object->add_triangles(world,tile.triangles);
+    tile.object->compress();
+}
+
+void cave_mesh::update_terrain(bool arch, bool ground)
+{
+    if(arch){
+        compute_surface(ArchSurface);
+        upload_surface(ArchSurface);
+        if(closed_ends){
+            compute_surface(Wall1Surface);
+            compute_surface(Wall2Surface);
+            upload_surface(Wall1Surface);
+            upload_surface(Wall2Surface);
         }
     }
+    if(ground){
+        compute_surface(GroundSurface);
+        upload_surface(GroundSurface);
+    }
+}
+
+void cave_mesh::update_collisions()
+{
+    // The previous collisions are all released, the partition is filled again
+    partition->clear();
+    arena->clear();
+    compute_collision_surfaces();
+    compute_collisions();
+}
 
-    for (int ku = 0; ku < N_ground-1; ++ku) {
-        for (int kv = 0; kv < N_ground-1; ++kv) {
-            int const idx = ku*N_ground+kv;
-            int const idx2 = ku*N_ground+kv+1;
-            int const idx3 = (ku+1)*N_ground+kv;
-            int const idx4 = (ku+1)*N_ground+kv+1;
-
-            vec3 pos1 = cmeshd_ground.model.scaling*cmeshd_ground.model.scaling_xyz*cmesh_ground.position[idx]+cmeshd_ground.model.translation;
-            vec3 pos2 = cmeshd_ground.model.scaling*cmeshd_ground.model.scaling_xyz*cmesh_ground.position[idx2]+cmeshd_ground.model.translation;
-            vec3 pos3 = cmeshd_ground.model.scaling*cmeshd_ground.model.scaling_xyz*cmesh_ground.position[idx3]+cmeshd_ground.model.translation;
-            vec3 pos4 = cmeshd_ground.model.scaling*cmeshd_ground.model.scaling_xyz*cmesh_ground.position[idx4]+cmeshd_ground.model.translation;
-
-            collision_object* tri1 = new collision_triangle(pos1,pos2-pos1,pos4-pos1);
-            collision_object* tri2 = new collision_triangle(pos1,pos3-pos1,pos4-pos1);
-            toDelete.push_back(tri1);
-            toDelete.push_back(tri2);
-            partition->add_collision(tri1);
-            partition->add_collision(tri2);
+cave_mesh::surface_buffers cave_mesh::get_surface(cave_surface which)
+{
+    if(which==GroundSurface){return {cmesh_ground, cmeshd_ground, lod_ground, tangents_ground, bitangents_ground, cmesh_collision_ground};}
+    if(which==Wall1Surface){return {cmesh_wall1, cmeshd_wall1, lod_wall1, tangents_wall1, bitangents_wall1, cmesh_collision_wall1};}
+    if(which==Wall2Surface){return {cmesh_wall2, cmeshd_wall2, lod_wall2, tangents_wall2, bitangents_wall2, cmesh_collision_wall2};}
+    return {cmesh, cmeshd, lod, tangents, bitangents, cmesh_collision};
+}
+
+void cave_mesh::compute_terrain()
+{
+    // The surfaces saved by a previous launch with the same parameters replace the whole generation
+    if(!load_cache()){
+        compute_surface(ArchSurface);
+        compute_surface(GroundSurface);
+        if(closed_ends){
+            compute_surface(Wall1Surface);
+            compute_surface(Wall2Surface);
         }
+        compute_collision_surfaces();
+        save_cache();
     }
+    sort_row_triangles(ArchSurface);
+    sort_row_triangles(GroundSurface);
+    sort_row_triangles(Wall1Surface);
+    sort_row_triangles(Wall2Surface);
+    lod.initialize(cmesh);
+    lod_ground.initialize(cmesh_ground);
+    lod_wall1.initialize(cmesh_wall1);
+    lod_wall2.initialize(cmesh_wall2);
+
+    compute_collisions();
+}
 
+void cave_mesh::compute_surface(cave_surface which)
+{
+    surface_buffers surface = get_surface(which);
+
+    // Recompute the new vertices
+    fill_surface(surface.shape,which);
     // Update the normal of the mesh structure
-    cmesh.normal_update();
-    cmesh_ground.normal_update();
-    cmesh_wall1.normal_update();
-    cmesh_wall2.normal_update();
+    surface.shape.normal_update();
+    tangent_space::compute(surface.shape,surface.tangents,surface.bitangents);
+    surface.lod.update_bounds(surface.shape);
+}
 
+void cave_mesh::sort_row_triangles(cave_surface which)
+{
+    mesh const& shape = get_surface(which).shape;
+    int const N = std::sqrt(shape.position.size());
+    std::vector<int> &first = row_first[which];
+    std::vector<int> &sorted = row_triangles[which];
+    first.assign(N+1,0);
+    sorted.resize(shape.connectivity.size());
+    if(N<2){return;}
+
+    // Counting sort on the quad row, keeping the connectivity order inside a row
+    std::vector<int> row(shape.connectivity.size());
+    for(int k=0;k<int(shape.connectivity.size());k++){
+        uint3 const& triangle = shape.connectivity[k];
+        row[k] = std::min(std::min(triangle[0]/N,triangle[1]/N),triangle[2]/N);
+        first[row[k]+1]++;
+    }
+    for(int ku=0;ku<N;ku++){
+        first[ku+1] += first[ku];
+    }
+    std::vector<int> fill(first.begin(),first.end()-1);
+    for(int k=0;k<int(shape.connectivity.size());k++){
+        sorted[fill[row[k]]++] = k;
+    }
+}
 
-    for (int ku = 0; ku < N; ++ku) {
-        for (int kv = 0; kv < N; ++kv) {
-            int const idx = ku*N+kv;
-            int idx2;
-            int idx3;
+float cave_mesh::relief_at(cave_surface which, float u, float v) const
+{
+    numarray<float> const& field = relief[which];
+    if(field.size()==0){return 0;}
+    // Bilinear interpolation of the relief, stored at the render resolution
+    int const N = std::sqrt(field.size());
+    float const cu = std::min(std::max(u,0.0f),1.0f)*(N-1);
+    float const cv = std::min(std::max(v,0.0f),1.0f)*(N-1);
+    int const iu = std::min(int(cu),N-2);
+    int const iv = std::min(int(cv),N-2);
+    float const tu = cu-iu;
+    float const tv = cv-iv;
+    return (1-tu)*((1-tv)*field[iu*N+iv]+tv*field[iu*N+iv+1]) + tu*((1-tv)*field[(iu+1)*N+iv]+tv*field[(iu+1)*N+iv+1]);
+}
 
-            if(ku==N-1 && kv==N-1){
-                idx2 = (ku-1)*N+kv-1;
-                idx3 = (ku-1)*N+kv;
-            }
-            else if(ku==N-1){
-                idx2 = ku*N+kv+1;
-                idx3 = (ku-1)*N+kv;
-            }
-            else if(kv==N-1){
-                idx2 = ku*N+kv-1;
-                idx3 = (ku+1)*N+kv;
-            }
-            else{
-                idx2 = (ku+1)*N+kv;
-                idx3 = (ku+1)*N+kv+1;
-            }
+void cave_mesh::brush(vec3 const& center, float radius, float strength)
+{
+    auto const start = std::chrono::steady_clock::now();
+
+    cave_surface const surfaces[4] = {ArchSurface, GroundSurface, Wall1Surface, Wall2Surface};
+    for(cave_surface which : surfaces){
+        surface_buffers surface = get_surface(which);
+        int const N = std::sqrt(surface.shape.position.size());
+        if(N<2){continue;}
+        if(relief[which].size()==0){
+            relief[which].resize(N*N);
+            std::fill(relief[which].begin(), relief[which].end(), 0.0f);
+        }
 
-            tangents[idx] = math::calculate_tangent(cmesh.position[idx],cmesh.position[idx2],cmesh.position[idx3],cmesh.uv[idx],cmesh.uv[idx2],cmesh.uv[idx3],cmesh.normal[idx]);
-            bitangents[idx] = math::calculate_bitangent(tangents[idx],cmesh.normal[idx]);
+        // The noise moves the ground up but the arch and the walls outwards.
+        // The strength is converted to the units of the displacement so that it does not depend on the terrain height
+        affine_rts const& model = surface.drawable.model;
+        float unit = model.scaling*model.scaling_xyz.y; // walls
+        if(which==ArchSurface){unit = model.scaling*model.scaling_xyz.x*scaling*r;}
+        if(which==GroundSurface){unit = model.scaling*model.scaling_xyz.z;}
+        float const amount = ((which==GroundSurface) ? strength : -strength)/unit;
+
+        // Only the samples of the LOD tiles intersecting the local bounding box of the brush are visited
+        vec3 const local = inverse(model.rotation)*((center-model.translation)/model.scaling);
+        vec3 box_min, box_max;
+        for(int k=0;k<3;k++){
+            float const half = radius/(model.scaling*model.scaling_xyz[k]);
+            box_min[k] = local[k]/model.scaling_xyz[k]-half;
+            box_max[k] = local[k]/model.scaling_xyz[k]+half;
+        }
+        int tu0, tu1, tv0, tv1;
+        if(!surface.lod.find_samples(box_min,box_max,tu0,tu1,tv0,tv1)){continue;}
+
+        // Smooth falloff up to radius around the center, in world space
+        std::vector<int> row_min(N,N);
+        std::vector<int> row_max(N,-1);
+        parallel::parallel_for(tu0, tu1+1, [&](int ku){
+            for (int kv = tv0; kv <= tv1; ++kv) {
+                int const idx = ku*N+kv;
+                vec3 const p = model.translation + model.scaling*(model.rotation*(model.scaling_xyz*surface.shape.position[idx]));
+                float const d = norm(p-center)/radius;
+                if(d>=1){continue;}
+                relief[which][idx] += amount*(1-d*d)*(1-d*d);
+                row_min[ku] = std::min(row_min[ku],kv);
+                row_max[ku] = std::max(row_max[ku],kv);
+            }
+        });
+
+        int ku0 = N, ku1 = -1, kv0 = N, kv1 = -1;
+        for(int ku=tu0;ku<=tu1;ku++){
+            if(row_max[ku]<0){continue;}
+            ku0 = std::min(ku0,ku);
+            ku1 = std::max(ku1,ku);
+            kv0 = std::min(kv0,row_min[ku]);
+            kv1 = std::max(kv1,row_max[ku]);
+        }
+        if(ku1>=0){
+            edit_surface(which,ku0,ku1,kv0,kv1);
         }
     }
 
-    for (int ku = 0; ku < N_wall; ++ku) {
-        for (int kv = 0; kv < N_wall; ++kv) {
-            int const idx = ku*N_wall+kv;
-            int idx2;
-            int idx3;
+    last_edit_time = std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now()-start).count();
+}
+
+void cave_mesh::edit_surface(cave_surface which, int ku0, int ku1, int kv0, int kv1)
+{
+    surface_buffers surface = get_surface(which);
+    int const N = std::sqrt(surface.shape.position.size());
+
+    // The moved rows, then the normals and tangents of every vertex sharing a triangle with them
+    fill_surface(surface.shape,which,ku0,ku1-ku0+1);
+    int const band0 = std::max(ku0-1,0);
+    int const band1 = std::min(ku1+1,N-1);
+    int const quad0 = std::max(band0-1,0);
+    int const quad1 = std::min(band1,N-2);
+    std::vector<int> const triangles(row_triangles[which].begin()+row_first[which][quad0], row_triangles[which].begin()+row_first[which][quad1+1]);
+    tangent_space::update_region(surface.shape,surface.tangents,surface.bitangents,triangles,band0*N,(band1+1)*N);
+
+    upload_surface(which,band0,band1-band0+1);
+    surface.lod.update_bounds(surface.shape,ku0,ku1,kv0,kv1);
+
+    // The relief is interpolated between the render vertices: the collision vertices up to one render cell away can move
+    float const cell = 1.0f/(N-1);
+    edit_collisions(which, (ku0-1)*cell, (ku1+1)*cell, (kv0-1)*cell, (kv1+1)*cell);
+}
 
-            if(ku==N_wall-1 && kv==N_wall-1){
-                idx2 = (ku-1)*N_wall+kv-1;
-                idx3 = (ku-1)*N_wall+kv;
-            }
-            else if(ku==N_wall-1){
-                idx2 = ku*N_wall+kv+1;
-                idx3 = (ku-1)*N_wall+kv;
-            }
-            else if(kv==N_wall-1){
-                idx2 = ku*N_wall+kv-1;
-                idx3 = (ku+1)*N_wall+kv;
-            }
-            else{
-                idx2 = (ku+1)*N_wall+kv;
-                idx3 = (ku+1)*N_wall+kv+1;
-            }
+void cave_mesh::edit_collisions(cave_surface which, float u_min, float u_max, float v_min, float v_max)
+{
+    surface_collisions &c = collisions[which];
+    if(c.source==NULL){return;}
+    surface_buffers surface = get_surface(which);
+    int const N = std::sqrt(c.source->position.size());
+
+    // Collision vertices in the edited (u,v) range
+    int const ku0 = std::max(int(std::floor(u_min*(N-1))),0);
+    int const ku1 = std::min(int(std::ceil(u_max*(N-1))),N-1);
+    int const kv0 = std::max(int(std::floor(v_min*(N-1))),0);
+    int const kv1 = std::min(int(std::ceil(v_max*(N-1))),N-1);
+    if(c.source==&surface.collision){
+        fill_surface(surface.collision,which,ku0,ku1-ku0+1);
+        // Render rows interpolated on the moved collision rows
+        int const N_render = std::sqrt(surface.shape.position.size());
+        float const rows = (N_render-1.0f)/(N-1);
+        update_collision_error(which, int(std::floor((ku0-1)*rows)), int(std::ceil((ku1+1)*rows)));
+    }
 
-            tangents_wall1[idx] = math::calculate_tangent(cmesh_wall1.position[idx],cmesh_wall1.position[idx2],cmesh_wall1.position[idx3],cmesh_wall1.uv[idx],cmesh_wall1.uv[idx2],cmesh_wall1.uv[idx3],cmesh_wall1.normal[idx]);
-            bitangents_wall1[idx] = math::calculate_bitangent(tangents_wall1[idx],cmesh_wall1.normal[idx]);
-            
-            tangents_wall2[idx] = math::calculate_tangent(cmesh_wall2.position[idx],cmesh_wall2.position[idx2],cmesh_wall2.position[idx3],cmesh_wall2.uv[idx],cmesh_wall2.uv[idx2],cmesh_wall2.uv[idx3],cmesh_wall2.normal[idx]);
-            bitangents_wall2[idx] = math::calculate_bitangent(tangents_wall1[idx],cmesh_wall2.normal[idx]);
-        }
+    if(c.whole!=NULL){
+        partition->remove_collision(c.whole);
+        c.whole->build();
+        partition->add_collision(c.whole);
+        return;
     }
 
-    for (int ku = 0; ku < N_ground; ++ku) {
-        for (int kv = 0; kv < N_ground; ++kv) {
-            int const idx = ku*N_ground+kv;
+    // Only the tiles with a quad using one of these vertices are rebuilt, from the world positions of their own vertices
+    std::vector<collision_tile*> edited;
+    int tu0 = N, tu1 = -1, tv0 = N, tv1 = -1;
+    for(collision_tile &tile : c.tiles){
+        if(tile.u1<ku0 || tile.u0>ku1 || tile.v1<kv0 || tile.v0>kv1){continue;}
+        edited.push_back(&tile);
+        tu0 = std::min(tu0,tile.u0);
+        tu1 = std::max(tu1,tile.u1);
+        tv0 = std::min(tv0,tile.v0);
+        tv1 = std::max(tv1,tile.v1);
+    }
+    if(edited.empty()){return;}
+    world_positions(which,edit_world,tu0,tu1,tv0,tv1);
+    for(collision_tile *tile : edited){
+        partition->remove_collision(tile->object);
+        fill_tile(*tile,edit_world);
+        partition->add_collision(tile->object);
+    }
+}
 
-            int idx2;
-            int idx3;
+void cave_mesh::compute_collision_surfaces()
+{
+    // Collision surfaces at their own resolution, the render meshes are used directly when the resolutions match
+    collision_max_error = 0;
+    std::fill(surface_error, surface_error+4, 0.0f);
+    update_collision_surface(ArchSurface);
+    update_collision_surface(GroundSurface);
+    if(closed_ends){
+        update_collision_surface(Wall1Surface);
+        update_collision_surface(Wall2Surface);
+    }
+}
 
-            if(ku==N_ground-1 && kv==N_ground-1){
-                idx2 = (ku-1)*N_ground+kv-1;
-                idx3 = (ku-1)*N_ground+kv;
-            }
-            else if(ku==N_ground-1){
-                idx2 = ku*N_ground+kv+1;
-                idx3 = (ku-1)*N_ground+kv;
-            }
-            else if(kv==N_ground-1){
-                idx2 = ku*N_ground+kv-1;
-                idx3 = (ku+1)*N_ground+kv;
-            }
-            else{
-                idx2 = (ku+1)*N_ground+kv;
-                idx3 = (ku+1)*N_ground+kv+1;
+void cave_mesh::compute_collisions()
+{
+    if(closed_ends){
+        add_collisions(Wall1Surface,collision_source(Wall1Surface),cmeshd_wall1);
+        add_collisions(Wall2Surface,collision_source(Wall2Surface),cmeshd_wall2);
+    }
+    add_collisions(ArchSurface,collision_source(ArchSurface),cmeshd);
+    add_collisions(GroundSurface,collision_source(GroundSurface),cmeshd_ground);
+    // Shown in the GUI
+    collision_triangles = 0;
+    collision_memory = 0;
+    if(compressed_collisions){
+        for(surface_collisions &c : collisions){
+            for(collision_tile &tile : c.tiles){
+                collision_triangles += tile.object->get_triangle_count();
+                collision_memory += tile.object->memory_footprint();
             }
-
-            tangents_ground[idx] = math::calculate_tangent(cmesh_ground.position[idx],cmesh_ground.position[idx2],cmesh_ground.position[idx3],cmesh_ground.uv[idx],cmesh_ground.uv[idx2],cmesh_ground.uv[idx3],cmesh_ground.normal[idx]);
-            bitangents_ground[idx] = math::calculate_bitangent(tangents_ground[idx],cmesh_ground.normal[idx]);
         }
     }
+}
 
+void cave_mesh::upload_surface(cave_surface which, int first_row, int row_count)
+{
+    surface_buffers surface = get_surface(which);
+    int const N = std::sqrt(surface.shape.position.size());
+    if(row_count<0){row_count = N-first_row;}
+    int const first = first_row*N;
+    int const count = row_count*N;
+
+    // The buffers created by upload() are overwritten in place, the colors and uv never change
+    gpu_buffer::update(surface.drawable.vbo_position, surface.shape.position, first, count);
+    gpu_buffer::update(surface.drawable.vbo_normal, surface.shape.normal, first, count);
+    gpu_buffer::attribute(surface.drawable, 0, surface.tangents, 4, first, count);
+    gpu_buffer::attribute(surface.drawable, 1, surface.bitangents, 5, first, count);
+}
 
+void cave_mesh::upload_tangents()
+{
+    // Supplementary buffers 0 and 1 of each drawable, created once and then updated by upload_surface()
+    gpu_buffer::attribute(cmeshd, 0, tangents, 4);
+    gpu_buffer::attribute(cmeshd, 1, bitangents, 5);
 
-    // Update step: Allows to update a mesh_drawable without creating a new one
-    cmeshd.vbo_position.update(cmesh.position);
-    cmeshd.vbo_normal.update(cmesh.normal);
-    cmeshd.vbo_color.update(cmesh.color);
-    cmeshd.initialize_supplementary_data_on_gpu(tangents,4);
-    cmeshd.initialize_supplementary_data_on_gpu(bitangents,5);
-    //cmeshd.supplementary_vbo.push_back(tangents_vbo);
-    //cmeshd.supplementary_vbo.push_back(bitangents_vbo);
+    gpu_buffer::attribute(cmeshd_ground, 0, tangents_ground, 4);
+    gpu_buffer::attribute(cmeshd_ground, 1, bitangents_ground, 5);
 
+    if(closed_ends){
+        gpu_buffer::attribute(cmeshd_wall1, 0, tangents_wall1, 4);
+        gpu_buffer::attribute(cmeshd_wall1, 1, bitangents_wall1, 5);
 
-    cmeshd_ground.vbo_position.update(cmesh_ground.position);
-    cmeshd_ground.vbo_normal.update(cmesh_ground.normal);
-    cmeshd_ground.vbo_color.update(cmesh_ground.color);
-    cmeshd_ground.initialize_supplementary_data_on_gpu(tangents_ground,4);
-    cmeshd_ground.initialize_supplementary_data_on_gpu(bitangents_ground,5);
+        gpu_buffer::attribute(cmeshd_wall2, 0, tangents_wall2, 4);
+        gpu_buffer::attribute(cmeshd_wall2, 1, bitangents_wall2, 5);
+    }
+}
 
+uint64_t cave_mesh::cache_key() const
+{
+    float const parameters[] = {float(cache_version),
+        float(octave), persistency, frequency_gain, terrain_height,
+        float(octave_ground), persistency_ground, frequency_gain_ground, terrain_height_ground,
+        r, def_r, scaling, length, float(chunk), float(closed_ends),
+        float(terrain_sample), float(arch_sample), float(wall_sample),
+        float(collision_terrain_sample), float(collision_arch_sample), float(collision_wall_sample)};
+    uint64_t key = binary_cache::hash(parameters, sizeof(parameters));
+    // The surfaces edited by the brush differ from the generated ones
+    for(numarray<float> const& field : relief){
+        if(field.size()>0){
+            key = binary_cache::hash(&field[0], field.size()*sizeof(float), key);
+        }
+    }
+    return key;
+}
 
-    cmeshd_wall1.vbo_position.update(cmesh_wall1.position);
-    cmeshd_wall1.vbo_normal.update(cmesh_wall1.normal);
-    cmeshd_wall1.vbo_color.update(cmesh_wall1.color);
-    cmeshd_wall1.initialize_supplementary_data_on_gpu(tangents_wall1,4);
-    cmeshd_wall1.initialize_supplementary_data_on_gpu(bitangents_wall1,5);
+bool cave_mesh::load_cache()
+{
+    if(!use_cache){return false;}
+    uint64_t const key = cache_key();
+    binary_cache::reader cache;
+    if(!cache.open(binary_cache::path("cave",key),key)){return false;}
+
+    cave_surface const surfaces[4] = {ArchSurface, GroundSurface, Wall1Surface, Wall2Surface};
+    for(cave_surface which : surfaces){
+        surface_buffers surface = get_surface(which);
+        size_t const N_vertex = surface.shape.uv.size(); // the grids are already created by generate()
+        bool valid = cache.read(surface.shape.position) && cache.read(surface.shape.normal)
+                  && cache.read(surface.tangents) && cache.read(surface.bitangents);
+        valid = valid && surface.shape.position.size()==N_vertex && surface.shape.normal.size()==N_vertex
+                      && surface.tangents.size()==N_vertex && surface.bitangents.size()==N_vertex;
+        if(&collision_source(which)==&surface.collision){
+            size_t const N_collision = surface.collision.position.size();
+            valid = valid && cache.read(surface.collision.position) && surface.collision.position.size()==N_collision;
+        }
+        if(!valid){
+            std::cout << "Cave cache: invalid file, the terrain is generated again" << std::endl;
+            return false;
+        }
+    }
+    numarray<float> error;
+    if(!cache.read(error) || error.size()!=4){return false;}
+    std::copy(error.begin(), error.end(), surface_error);
+    collision_max_error = *std::max_element(surface_error, surface_error+4);
+    for(std::vector<float> &errors : row_error){
+        errors.clear(); // computed again at the first edit of the surface
+    }
+    return true;
+}
 
-    cmeshd_wall2.vbo_position.update(cmesh_wall2.position);
-    cmeshd_wall2.vbo_normal.update(cmesh_wall2.normal);
-    cmeshd_wall2.vbo_color.update(cmesh_wall2.color);
-    cmeshd_wall2.initialize_supplementary_data_on_gpu(tangents_wall2,4);
-    cmeshd_wall2.initialize_supplementary_data_on_gpu(bitangents_wall2,5);
+void cave_mesh::save_cache()
+{
+    if(!use_cache){return;}
+    uint64_t const key = cache_key();
+    binary_cache::writer cache;
+    if(!cache.open(binary_cache::path("cave",key),key)){return;}
+
+    cave_surface const surfaces[4] = {ArchSurface, GroundSurface, Wall1Surface, Wall2Surface};
+    for(cave_surface which : surfaces){
+        surface_buffers surface = get_surface(which);
+        cache.write(surface.shape.position);
+        cache.write(surface.shape.normal);
+        cache.write(surface.tangents);
+        cache.write(surface.bitangents);
+        if(&collision_source(which)==&surface.collision){
+            cache.write(surface.collision.position);
+        }
+    }
+    numarray<float> error;
+    error.resize(4);
+    std::copy(surface_error, surface_error+4, error.begin());
+    cache.write(error);
+    if(!cache.close()){
+        std::cout << "Cave cache: could not write the cache file" << std::endl;
+    }
+}
+
+void cave_mesh::addAssets(asset_loader &loader)
+{
+    loader.add_texture(project::path + "assets/rock_face_comp.png", GL_REPEAT, GL_REPEAT);
+    loader.add_texture(project::path + "assets/rock_face_normal_comp.png");
 }
 
 opengl_shader_structure cave_mesh::getShader()
 {
     if(!initialized_textures){
-        texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_comp.png",
+        texture = asset_registry::get_texture(project::path + "assets/rock_face_comp.png",
             GL_REPEAT,
             GL_REPEAT);
-        normal_map_texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_normal_comp.png");
+        normal_map_texture = asset_registry::get_texture(project::path + "assets/rock_face_normal_comp.png");
         shader.load(project::path + "shaders/normal_map/mesh_normal.vert.glsl", project::path + "shaders/normal_map/mesh_normal.frag.glsl");
+        environment_structure::bind_lights(shader);
+        render_queue::add_prepass_shader(shader);
         initialized_textures = true;
     }
     return shader;
@@ -1,14 +1,23 @@
 #ifndef CAVE_MESH_H
 #define CAVE_MESH_H
 
+#include <cstdint>
+
 #include "cgp/cgp.hpp"
 #include "../environment.hpp"
 #include "../utils/collision_handler.hpp"
 #include "../utils/collision_object.hpp"
 #include "../utils/touchable_object.hpp"
+#include "../utils/collision_arena.hpp"
+#include "../utils/collision_mesh.hpp"
+#include "../utils/collision_compressed_mesh.hpp"
+#include "../utils/lod_grid.hpp"
+#include "../utils/asset_loader.hpp"
 
 class cave_mesh: public collision_handler
 {
+public:
+    enum cave_surface {ArchSurface, GroundSurface, Wall1Surface, Wall2Surface};
 private:
     cgp::mesh cmesh;
     cgp::mesh_drawable cmeshd;
@@ -20,9 +29,90 @@ private:
     cgp::mesh cmesh_wall2;
     cgp::mesh_drawable cmeshd_wall2;
 
-    bool createdPartition = true;
+    // Collision surfaces, only used when the collision resolution is lower than the render one
+    cgp::mesh cmesh_collision;
+    cgp::mesh cmesh_collision_ground;
+    cgp::mesh cmesh_collision_wall1;
+    cgp::mesh cmesh_collision_wall2;
+
+    // Levels of detail of the index buffers, by tiles
+    lod_grid lod;
+    lod_grid lod_ground;
+    lod_grid lod_wall1;
+    lod_grid lod_wall2;
+
+    cgp::numarray<cgp::vec3> tangents;
+    cgp::numarray<cgp::vec3> bitangents;
+    cgp::numarray<cgp::vec3> tangents_ground;
+    cgp::numarray<cgp::vec3> bitangents_ground;
+    cgp::numarray<cgp::vec3> tangents_wall1;
+    cgp::numarray<cgp::vec3> bitangents_wall1;
+    cgp::numarray<cgp::vec3> tangents_wall2;
+    cgp::numarray<cgp::vec3> bitangents_wall2;
 
-    std::vector<collision_object*> toDelete;
+    bool createdPartition = true;
+    bool createdArena = true;
+
+    collision_arena *arena = NULL;
+
+    // Everything that belongs to one surface
+    struct surface_buffers{
+        cgp::mesh &shape;
+        cgp::mesh_drawable &drawable;
+        lod_grid &lod;
+        cgp::numarray<cgp::vec3> &tangents;
+        cgp::numarray<cgp::vec3> &bitangents;
+        cgp::mesh &collision; // collision grid, unused when the collisions use the render mesh
+    };
+    surface_buffers get_surface(cave_surface which);
+
+    // Collisions of a surface, split in tiles of its collision grid so that an edit only rebuilds the tiles it touches
+    struct collision_tile{
+        int u0,u1,v0,v1; // quads [u0,u1[ x [v0,v1[ of the collision grid
+        cgp::numarray<cgp::uint3> triangles;
+        collision_compressed_mesh *object = NULL;
+    };
+    struct surface_collisions{
+        cgp::mesh const* source = NULL; // collision grid or render mesh
+        std::vector<collision_tile> tiles;
+        collision_mesh *whole = NULL; // single object referencing source, when the collisions are not compressed
+    };
+    surface_collisions collisions[4]; // by cave_surface
+    static int const collision_tiles = 8; // tiles per side
+
+    // Triangles of the render grids sorted by quad row, to update the normals of a band of rows after an edit
+    std::vector<int> row_first[4];
+    std::vector<int> row_triangles[4];
+    // Displacement added by the brush, in the units of the noise height, at the render resolution (empty until the first edit)
+    cgp::numarray<float> relief[4];
+    cgp::numarray<cgp::vec3> edit_world; // world positions of the collision grid, kept between edits
+
+    void add_collisions(cave_surface which, cgp::mesh const& surface, cgp::mesh_drawable const& surfaced);
+    // World positions of the collision source, only the samples [ku0,ku1] x [kv0,kv1] are computed (all when negative)
+    void world_positions(cave_surface which, cgp::numarray<cgp::vec3> &world, int ku0 = 0, int ku1 = -1, int kv0 = 0, int kv1 = -1);
+    void fill_tile(collision_tile &tile, cgp::numarray<cgp::vec3> const& world);
+    void sort_row_triangles(cave_surface which);
+    float relief_at(cave_surface which, float u, float v) const;
+    void edit_surface(cave_surface which, int ku0, int ku1, int kv0, int kv1);
+    void edit_collisions(cave_surface which, float u_min, float u_max, float v_min, float v_max);
+    void fill_surface(cgp::mesh &surface, cave_surface which, int first_row = 0, int row_count = -1);
+    cgp::mesh const& collision_source(cave_surface which); // collision grid of the surface, or its render mesh
+    void update_collision_surface(cave_surface which);
+    // Largest deviation of each render row from the collision triangles, and of each surface (0 when the render mesh is used)
+    std::vector<float> row_error[4];
+    float surface_error[4] = {0,0,0,0};
+    void update_collision_error(cave_surface which, int first_row, int last_row); // rows of the render grid, then collision_max_error
+    int get_collision_sample(cave_surface which);
+    void place_surfaces();
+    void compute_terrain();
+    void compute_surface(cave_surface which);
+    void compute_collision_surfaces();
+    void compute_collisions();
+    uint64_t cache_key() const;
+    bool load_cache();
+    void save_cache();
+    void upload_surface(cave_surface which, int first_row = 0, int row_count = -1);
+    void upload_tangents();
 
 
 public:
@@ -33,10 +123,19 @@ public:
     static int const arch_sample = 200;
     static int const wall_sample = 150;
 
+    // Resolution of the collision surfaces, independent from the render one (>= render sample to use the render mesh)
+    int collision_terrain_sample = 150;
+    int collision_arch_sample = 100;
+    int collision_wall_sample = 75;
+    float collision_max_error = 0; // Maximal distance between a render vertex and the collision surface
+    int collision_triangles = 0; // Triangles of the compressed collision tiles
+    size_t collision_memory = 0;
+
     static bool initialized_textures;
     static opengl_texture_image_structure texture;
     static opengl_texture_image_structure normal_map_texture;
     static opengl_shader_structure shader;
+    static bool use_lod; // Reduce the resolution of the tiles out of the fog distance
 
     int octave = 8;
     float persistency = 0.7;
@@ -49,6 +148,12 @@ public:
 
     float quadraticWeight = 1.0;
 
+    bool compressed_collisions = true; // Store the collision triangles quantised per partition cell
+
+    // Reuse the surfaces generated by a previous launch with the same parameters (files in cache/)
+    bool use_cache = true;
+    static int const cache_version = 2; // to increase when the generation changes
+
     timer_basic timer;
 
 
@@ -59,12 +164,44 @@ public:
 
     float length = 2;
 
+    int chunk = 0; // Index of the segment along the tunnel axis, the segment k is translated by k*segment_length()
+    bool closed_ends = true; // Generate the walls closing both ends of the segment
+
+    float segment_length() const {return segment_length(scaling,length);}
+    static float segment_length(float scaling, float length); // Length along y of a segment with these parameters
+
     void initialize();
+    // initialize() is generate() followed by upload(): generate() only does CPU work (meshes, collisions) and can run on another thread,
+    // upload() sends the result to the GPU and must be called from the OpenGL thread
+    void generate();
+    void upload();
+    void clear(); // Release the GPU buffers
+
+    int drawn_triangles(); // Triangles sent at the last draw, with the levels of detail
+    int full_triangles();
     void initialize(collision_partition *_partition);
-    void draw(environment_structure environment);
-    void update_terrain();
+    // The partition and the arena must only hold the cave collisions: they are cleared by update_collisions()
+    void initialize(collision_partition *_partition, collision_arena *_arena);
+    void draw(environment_structure const& environment);
+    // Recompute the arch (and walls) and/or the ground from the current parameters. The GPU buffers are updated in place,
+    // the collisions are kept: call update_collisions() once the parameters are settled
+    void update_terrain(bool arch = true, bool ground = true);
+    void update_collisions();
+    void display_gui(); // Live edition of the noise parameters
+    // Move the surfaces around the world position center towards the inside of the cave (strength>0) or dig them (strength<0),
+    // by strength world units at the center.
+    // Only the touched rows are recomputed and uploaded, and only the touched collision tiles are rebuilt
+    void brush(cgp::vec3 const& center, float radius, float strength);
+    float last_edit_time = 0; // Duration of the last brush, in ms
+    float tangent_time = 0; // Duration of tangent_space::compute on the arch, in ms (timed from the GUI)
+    cgp::vec3 surface_position(cave_surface surface, float u, float v) const;
+    // relief is added to the displacement given by the noise, independently of the terrain height
+    cgp::vec3 surface_position(cave_surface surface, float u, float v, float noise, float relief = 0) const;
+    cgp::vec2 noise_coordinates(cave_surface surface, float u, float v) const;
+    void surface_noise(cave_surface surface, cgp::numarray<cgp::vec2> const& coordinates, cgp::numarray<float> &noise) const;
 
     static opengl_shader_structure getShader();
+    static void addAssets(asset_loader &loader); // Textures loaded by getShader()
 };
 
 #endif // CAVE_MESH_H
@@ -0,0 +1,209 @@
+#include "cave_stream.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cgp;
+
+
+cave_stream::~cave_stream(){
+    stop();
+}
+
+cave_mesh* cave_stream::create_chunk(int index){
+    cave_mesh *chunk = new cave_mesh();
+    chunk->chunk = index;
+    chunk->scaling = scaling;
+    chunk->length = length;
+    chunk->closed_ends = false;
+    chunk->use_cache = false; // the number of chunks is not bounded
+    chunk->generate();
+    return chunk;
+}
+
+void cave_stream::worker_loop(){
+    while(true){
+        int index;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this](){return stopping || !queue.empty();});
+            if(stopping){
+                return;
+            }
+            index = queue.front();
+            queue.pop_front();
+        }
+
+        cave_mesh *chunk = create_chunk(index);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        built.push_back(chunk);
+    }
+}
+
+void cave_stream::start(){
+    if(running){return;}
+    running = true;
+    stopping = false;
+#ifndef __EMSCRIPTEN__
+    worker = std::thread(&cave_stream::worker_loop, this);
+#endif
+}
+
+void cave_stream::stop(){
+    if(!running){return;}
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    if(worker.joinable()){
+        worker.join();
+    }
+
+    for(cave_mesh *chunk : built){
+        delete chunk; // never uploaded
+    }
+    built.clear();
+    queue.clear();
+    requested.clear();
+    for(auto &loaded : chunks){
+        loaded.second->clear();
+        delete loaded.second;
+    }
+    chunks.clear();
+    running = false;
+}
+
+int cave_stream::chunk_index(vec3 const& position) const{
+    // The chunk k covers [(k-1/2)*segment_length, (k+1/2)*segment_length] along y
+    return std::floor(position.y/cave_mesh::segment_length(scaling,length) + 0.5f);
+}
+
+void cave_stream::update(vec3 const& position){
+    if(!running){return;}
+
+    int const current = chunk_index(position);
+    int const first = current-chunks_behind;
+    int const last = current+chunks_ahead;
+
+    std::vector<cave_mesh*> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.swap(built);
+
+        // Forget the queued chunks that left the window
+        std::deque<int> kept;
+        for(int index : queue){
+            if(index>=first && index<=last){
+                kept.push_back(index);
+            }
+            else{
+                requested.erase(index);
+            }
+        }
+        queue.swap(kept);
+
+        // Closest chunks first
+        for(int d=0; d<=std::max(chunks_behind,chunks_ahead); d++){
+            int const candidates[2] = {current+d, current-d};
+            for(int k=0; k<(d==0 ? 1 : 2); k++){
+                int const index = candidates[k];
+                if(index<first || index>last){continue;}
+                if(chunks.count(index)>0 || requested.count(index)>0){continue;}
+                queue.push_back(index);
+                requested.insert(index);
+            }
+        }
+    }
+    condition.notify_one();
+
+#ifdef __EMSCRIPTEN__
+    // No worker thread: one chunk is generated per frame
+    if(!queue.empty()){
+        ready.push_back(create_chunk(queue.front()));
+        queue.pop_front();
+    }
+#endif
+
+    for(cave_mesh *chunk : ready){
+        requested.erase(chunk->chunk);
+        if(chunk->chunk>=first && chunk->chunk<=last && chunks.count(chunk->chunk)==0){
+            chunk->upload();
+            chunks[chunk->chunk] = chunk;
+        }
+        else{
+            delete chunk;
+        }
+    }
+
+    // The followed position must always stand on a loaded chunk: generate it right away if the worker is late
+    if(chunks.count(current)==0){
+        cave_mesh *chunk = create_chunk(current);
+        chunk->upload();
+        chunks[current] = chunk;
+    }
+
+    // Evict the chunks out of the window, with a margin of one chunk to avoid reloading when going back and forth at a boundary
+    for(auto it=chunks.begin(); it!=chunks.end();){
+        if(it->first<first-1 || it->first>last+1){
+            it->second->clear();
+            delete it->second;
+            it = chunks.erase(it);
+        }
+        else{
+            ++it;
+        }
+    }
+}
+
+void cave_stream::draw(environment_structure const& environment){
+    for(auto &loaded : chunks){
+        loaded.second->draw(environment);
+    }
+}
+
+int cave_stream::drawn_triangles(){
+    int count = 0;
+    for(auto &loaded : chunks){
+        count += loaded.second->drawn_triangles();
+    }
+    return count;
+}
+
+int cave_stream::full_triangles(){
+    int count = 0;
+    for(auto &loaded : chunks){
+        count += loaded.second->full_triangles();
+    }
+    return count;
+}
+
+bool cave_stream::does_collide(collision_object* col2, vec3 &collision_point){
+    collision_ray* ray = dynamic_cast<collision_ray*>(col2);
+    if(ray==nullptr){
+        return false;
+    }
+    // Only the chunks overlapping the ray along the tunnel axis are tested,
+    // each chunk resolving the ray in its own partition
+    float const y_min = std::min(ray->translation.y, ray->translation.y+ray->director.y);
+    float const y_max = std::max(ray->translation.y, ray->translation.y+ray->director.y);
+
+    float min_dist = -1;
+    vec3 temp;
+    for(auto &loaded : chunks){
+        cave_mesh *chunk = loaded.second;
+        float const center = chunk->chunk*chunk->segment_length();
+        float const half = chunk->segment_length()/2;
+        if(y_max<center-half || y_min>center+half){continue;}
+
+        if(chunk->does_collide(col2, temp)){
+            float const dist = norm(ray->translation-temp);
+            if(min_dist==-1 || dist<min_dist){
+                min_dist = dist;
+                collision_point = temp;
+            }
+        }
+    }
+    return min_dist>=0;
+}
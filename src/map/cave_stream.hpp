@@ -0,0 +1,67 @@
+#ifndef CAVE_STREAM_H
+#define CAVE_STREAM_H
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "../environment.hpp"
+#include "cave_mesh.hpp"
+
+// Endless cave made of open cave_mesh segments (chunks) placed one after the other along the y axis.
+// The chunks around the followed position are generated on a background thread, uploaded to the GPU by update()
+// and evicted once they are too far, so that memory and generation cost do not depend on the distance travelled.
+// Each chunk owns its render meshes, its collision partition and its collision arena.
+class cave_stream
+{
+private:
+    std::map<int, cave_mesh*> chunks; // loaded chunks by index, only used by the main thread
+    std::set<int> requested;          // chunks queued or being generated
+
+    // Shared with the worker thread
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<int> queue;
+    std::vector<cave_mesh*> built;
+    bool stopping = false;
+
+    std::thread worker;
+    bool running = false;
+
+    cave_mesh* create_chunk(int index);
+    void worker_loop();
+
+public:
+    cave_stream(){}
+    ~cave_stream();
+
+    int chunks_behind = 1; // number of chunks kept behind the current one
+    int chunks_ahead = 2;  // number of chunks generated in advance
+
+    // Parameters of the chunks, to set before start()
+    float scaling = 1;
+    float length = 2;
+
+    void start();
+    void stop(); // Stop the worker and release every chunk
+    bool is_running(){return running;}
+
+    int chunk_index(cgp::vec3 const& position) const;
+    // Request the chunks around position, upload the chunks generated since the last call and evict the far ones
+    void update(cgp::vec3 const& position);
+    void draw(environment_structure const& environment);
+
+    bool does_collide(collision_object* col2, cgp::vec3 &collision_point);
+
+    int loaded_chunks(){return chunks.size();}
+    int pending_chunks(){return requested.size();}
+    int drawn_triangles();
+    int full_triangles();
+};
+
+#endif // CAVE_STREAM_H
@@ -1,10 +1,16 @@
 #include "cristal.hpp"
+#include "../utils/asset_registry.hpp"
+#include "../utils/gpu_buffer.hpp"
+
+#include <algorithm>
+#include <cmath>
 
 
 bool cristal::texturesInitialized = false;
 opengl_texture_image_structure cristal::texture_purple;
 opengl_texture_image_structure cristal::texture_orange;
 opengl_shader_structure cristal::cristal_shader;
+opengl_shader_structure cristal::cristal_instanced_shader;
 
 cristal::cristal(){
     toDraw.material.phong.ambient=1;
@@ -16,13 +22,25 @@ cristal::cristal(){
 void cristal::checkTextures()
 {
     if(!texturesInitialized){
-        texture_purple.load_and_initialize_texture_2d_on_gpu(project::path+"assets/cristal/textures/Cristals.png",GL_REPEAT,GL_REPEAT);
-        texture_orange.load_and_initialize_texture_2d_on_gpu(project::path+"assets/cristal/textures/Cristals2.png",GL_REPEAT,GL_REPEAT);
+        texture_purple = asset_registry::get_texture(project::path+"assets/cristal/textures/Cristals.png",GL_REPEAT,GL_REPEAT);
+        texture_orange = asset_registry::get_texture(project::path+"assets/cristal/textures/Cristals2.png",GL_REPEAT,GL_REPEAT);
         cristal_shader.load(project::path + "shaders/cristal_shader/cristal.vert.glsl", project::path + "shaders/cristal_shader/cristal.frag.glsl");
+        environment_structure::bind_lights(cristal_shader);
+        cristal_instanced_shader.load(project::path + "shaders/cristal_shader/cristal_instanced.vert.glsl", project::path + "shaders/cristal_shader/cristal.frag.glsl");
+        environment_structure::bind_lights(cristal_instanced_shader);
         texturesInitialized = true;
     }
 }
 
+void cristal::addAssets(asset_loader &loader)
+{
+    loader.add_mesh(project::path+"assets/cristal/cristals2.obj");
+    loader.add_mesh(project::path+"assets/cristal/cristals3.obj");
+    loader.add_mesh(project::path+"assets/cristal/cristals4.obj");
+    loader.add_texture(project::path+"assets/cristal/textures/Cristals.png",GL_REPEAT,GL_REPEAT);
+    loader.add_texture(project::path+"assets/cristal/textures/Cristals2.png",GL_REPEAT,GL_REPEAT);
+}
+
 void cristal::update(){
     toDraw.model.scaling = scaling;
     toDraw.model.scaling_xyz = scaling_xyz;
@@ -36,8 +54,19 @@ void cristal::update(){
     toDraw.shader = cristal_shader;
 }
 
-void cristal::draw(environment_structure environment){    
-    cgp::draw(toDraw,environment);
+void cristal::draw(environment_structure const& environment){    
+    environment.draw(toDraw);
+}
+
+void cristal::addMeshCollisions(mesh const& source, collision_partition *partition, collision_arena *arena){
+    // The triangles reference the shared crystal mesh, only the transform is specific to this crystal
+    collision_mesh* col = arena->create<collision_mesh>(partition,&source);
+    col->translation = translation;
+    col->rotation = rotation;
+    col->scaling = scaling;
+    col->scaling_xyz = scaling_xyz;
+    col->build();
+    partition->add_collision(col);
 }
 
 light_params cristal::getLightParams(){
@@ -49,6 +78,7 @@ mesh cristal_ram::cristal;
 mesh_drawable cristal_ram::cristald;
 void cristal_ram::chooseTexture(){
     toDraw.texture = cristal::texture_purple;
+    texture_index = 0;
 }
 cristal_ram::cristal_ram(){
     intensity = 1.5;
@@ -59,8 +89,8 @@ cristal_ram::cristal_ram(){
 void cristal_ram::initialize()
 {
     if(!initialized){
-        cristal = mesh_load_file_obj(project::path+"assets/cristal/cristals2.obj");
-        cristald.initialize_data_on_gpu(cristal);
+        cristal = asset_registry::get_mesh(project::path+"assets/cristal/cristals2.obj");
+        cristald = asset_registry::get_drawable(project::path+"assets/cristal/cristals2.obj");
         initialized = true;
     }
     toDraw = cristald;
@@ -68,15 +98,8 @@ void cristal_ram::initialize()
     chooseTexture();
 }
 
-void cristal_ram::addCollisions(collision_partition *partition){
-    for(int i=0;i<cristal.connectivity.size();i++){
-        uint3 indexes = cristal.connectivity[i];
-        vec3 pos1 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[0]]);
-        vec3 pos2 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[1]]);
-        vec3 pos3 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[2]]);
-
-        partition->add_collision(new collision_triangle(pos1,pos2-pos1,pos3-pos1));
-    }
+void cristal_ram::addCollisions(collision_partition *partition, collision_arena *arena){
+    addMeshCollisions(cristal,partition,arena);
 }
 
 vec3 cristal_ram::getLightPosition()
@@ -95,6 +118,7 @@ mesh cristal_rock::cristal;
 mesh_drawable cristal_rock::cristald;
 void cristal_rock::chooseTexture(){
     toDraw.texture = cristal::texture_purple;
+    texture_index = 0;
 }
 cristal_rock::cristal_rock(){
     intensity = 1.5;
@@ -105,8 +129,8 @@ cristal_rock::cristal_rock(){
 void cristal_rock::initialize()
 {
     if(!initialized){
-        cristal = mesh_load_file_obj(project::path+"assets/cristal/cristals3.obj");
-        cristald.initialize_data_on_gpu(cristal);
+        cristal = asset_registry::get_mesh(project::path+"assets/cristal/cristals3.obj");
+        cristald = asset_registry::get_drawable(project::path+"assets/cristal/cristals3.obj");
         initialized = true;
     }
     toDraw = cristald;
@@ -114,15 +138,8 @@ void cristal_rock::initialize()
     chooseTexture();
 }
 
-void cristal_rock::addCollisions(collision_partition *partition){
-    for(int i=0;i<cristal.connectivity.size();i++){
-        uint3 indexes = cristal.connectivity[i];
-        vec3 pos1 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[0]]);
-        vec3 pos2 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[1]]);
-        vec3 pos3 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[2]]);
-
-        partition->add_collision(new collision_triangle(pos1,pos2-pos1,pos3-pos1));
-    }
+void cristal_rock::addCollisions(collision_partition *partition, collision_arena *arena){
+    addMeshCollisions(cristal,partition,arena);
 }
 
 vec3 cristal_rock::getLightPosition()
@@ -143,6 +160,7 @@ mesh cristal_large::cristal;
 mesh_drawable cristal_large::cristald;
 void cristal_large::chooseTexture(){
     toDraw.texture = cristal::texture_purple;
+    texture_index = 0;
 }
 cristal_large::cristal_large(){
     intensity = 1.5;
@@ -153,8 +171,8 @@ cristal_large::cristal_large(){
 void cristal_large::initialize()
 {
     if(!initialized){
-        cristal = mesh_load_file_obj(project::path+"assets/cristal/cristals4.obj");
-        cristald.initialize_data_on_gpu(cristal);
+        cristal = asset_registry::get_mesh(project::path+"assets/cristal/cristals4.obj");
+        cristald = asset_registry::get_drawable(project::path+"assets/cristal/cristals4.obj");
         initialized = true;
     }
     toDraw = cristald;
@@ -162,15 +180,8 @@ void cristal_large::initialize()
     chooseTexture();
 }
 
-void cristal_large::addCollisions(collision_partition *partition){
-    for(int i=0;i<cristal.connectivity.size();i++){
-        uint3 indexes = cristal.connectivity[i];
-        vec3 pos1 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[0]]);
-        vec3 pos2 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[1]]);
-        vec3 pos3 = translation + scaling * scaling_xyz * (rotation * cristal.position[indexes[2]]);
-
-        partition->add_collision(new collision_triangle(pos1,pos2-pos1,pos3-pos1));
-    }
+void cristal_large::addCollisions(collision_partition *partition, collision_arena *arena){
+    addMeshCollisions(cristal,partition,arena);
 }
 
 vec3 cristal_large::getLightPosition()
@@ -185,6 +196,7 @@ vec3 cristal_large::getLightPosition()
 
 void cristal_rock_gold::chooseTexture(){
     toDraw.texture = cristal::texture_orange;
+    texture_index = 1;
 }
 
 cristal_rock_gold::cristal_rock_gold()
@@ -194,6 +206,7 @@ cristal_rock_gold::cristal_rock_gold()
 
 void cristal_large_gold::chooseTexture(){
     toDraw.texture = cristal::texture_orange;
+    texture_index = 1;
 }
 
 cristal_large_gold::cristal_large_gold(){
@@ -202,8 +215,116 @@ cristal_large_gold::cristal_large_gold(){
 
 void cristal_ram_gold::chooseTexture(){
     toDraw.texture = cristal::texture_orange;
+    texture_index = 1;
 }
 
 cristal_ram_gold::cristal_ram_gold(){
     color = {1,0.5,0};
 }
+
+
+
+void cristal_renderer::add(cristal const& c){
+    mesh const* shape = c.getMesh();
+    if(shape==NULL){
+        return;
+    }
+    batch *b = NULL;
+    for(batch &existing : batches){
+        if(existing.shape==shape){
+            b = &existing;
+        }
+    }
+    if(b==NULL){
+        batches.push_back(batch());
+        b = &batches.back();
+        b->shape = shape;
+        for(vec3 const& p : shape->position){
+            b->radius = std::max(b->radius, norm(p));
+        }
+        b->drawable.initialize_data_on_gpu(*shape);
+        b->drawable.shader = cristal::cristal_instanced_shader;
+        b->drawable.texture = cristal::texture_purple;
+        b->drawable.supplementary_texture["image_texture_2"] = cristal::texture_orange;
+        b->drawable.material = c.toDraw.material;
+        b->drawable.material.color = {1,1,1}; // per instance
+    }
+    quaternion const q = c.rotation.get_quaternion();
+    instance i;
+    i.translation = c.translation;
+    i.rotation = vec4(q.x,q.y,q.z,q.w);
+    i.scaling = c.scaling*c.scaling_xyz;
+    i.texture = float(c.texture_index);
+    i.color = c.toDraw.material.color;
+    i.radius = b->radius*std::max(std::abs(i.scaling.x), std::max(std::abs(i.scaling.y), std::abs(i.scaling.z)));
+    b->instances.push_back(i);
+    b->changed = true;
+}
+
+void cristal_renderer::clear(){
+    for(batch &b : batches){
+        b.instances.clear();
+        b.changed = true;
+    }
+}
+
+int cristal_renderer::size() const{
+    int count = 0;
+    for(batch const& b : batches){
+        count += b.instances.size();
+    }
+    return count;
+}
+
+int cristal_renderer::drawCalls() const{
+    int count = 0;
+    for(batch const& b : batches){
+        count += b.visible.size()>0 ? 1 : 0;
+    }
+    return count;
+}
+
+void cristal_renderer::upload(batch &b){
+    b.translations.resize(b.visible.size());
+    b.rotations.resize(b.visible.size());
+    b.scalings.resize(b.visible.size());
+    b.textures.resize(b.visible.size());
+    b.colors.resize(b.visible.size());
+    for(size_t k=0;k<b.visible.size();k++){
+        instance const& i = b.instances[b.visible[k]];
+        b.translations[k] = i.translation;
+        b.rotations[k] = i.rotation;
+        b.scalings[k] = i.scaling;
+        b.textures[k] = i.texture;
+        b.colors[k] = i.color;
+    }
+    if(b.visible.empty()){
+        return;
+    }
+    gpu_buffer::attribute(b.drawable, 0, b.translations, 4, 0, -1, 1);
+    gpu_buffer::attribute(b.drawable, 1, b.rotations, 5, 0, -1, 1);
+    gpu_buffer::attribute(b.drawable, 2, b.scalings, 6, 0, -1, 1);
+    gpu_buffer::attribute(b.drawable, 3, b.textures, 7, 0, -1, 1);
+    gpu_buffer::attribute(b.drawable, 4, b.colors, 8, 0, -1, 1);
+}
+
+void cristal_renderer::draw(environment_structure const& environment){
+    for(batch &b : batches){
+        visible.clear();
+        for(int k=0;k<int(b.instances.size());k++){
+            instance const& i = b.instances[k];
+            if(environment.view_frustum.is_sphere_visible(i.translation,i.radius)){
+                visible.push_back(k);
+            }
+        }
+        if(b.changed || visible!=b.visible){
+            b.visible.swap(visible);
+            upload(b);
+            b.changed = false;
+        }
+        if(b.visible.empty()){
+            continue;
+        }
+        environment.draw(b.drawable, int(b.visible.size()));
+    }
+}
@@ -4,15 +4,21 @@
 #include "../environment.hpp"
 #include "../utils/collision_handler.hpp"
 #include "../utils/collision_object.hpp"
+#include "../utils/collision_arena.hpp"
+#include "../utils/collision_mesh.hpp"
+#include "../utils/asset_loader.hpp"
 
 using namespace cgp;
 
 class cristal{
+protected:
+    void addMeshCollisions(mesh const& source, collision_partition *partition, collision_arena *arena);
 public:
     static bool texturesInitialized;
     static opengl_texture_image_structure texture_purple;
     static opengl_texture_image_structure texture_orange;
     static opengl_shader_structure cristal_shader;
+    static opengl_shader_structure cristal_instanced_shader; // used by cristal_renderer
     vec3 translation={0,0,0};
     rotation_transform rotation;
     float scaling = 1;
@@ -24,18 +30,21 @@ public:
     float distance = 7;
 
     vec3 color = {1,1,1};
+    int texture_index = 0; // 0: texture_purple, 1: texture_orange
 
 
     float lightDistance;
     float lightIntensity;
     cristal();
     virtual void initialize(){}
-    virtual void initialize(collision_partition *partition){initialize();addCollisions(partition);}
-    virtual void addCollisions(collision_partition *partition){if(partition==NULL){}}
+    virtual void initialize(collision_partition *partition, collision_arena *arena){initialize();addCollisions(partition,arena);}
+    virtual void addCollisions(collision_partition *partition, collision_arena *arena){if(partition==NULL || arena==NULL){}}
     void checkTextures();
+    static void addAssets(asset_loader &loader); // Meshes and textures of every kind of crystal
     void update();
-    virtual void draw(environment_structure environment);
+    virtual void draw(environment_structure const& environment);
     virtual vec3 getLightPosition(){return translation;}
+    virtual mesh const* getMesh() const {return NULL;} // Shared mesh of this kind of crystal
     virtual light_params getLightParams();
 };
 
@@ -51,8 +60,9 @@ public:
 
 
     void initialize() override;
-    void addCollisions(collision_partition *partition) override;
+    void addCollisions(collision_partition *partition, collision_arena *arena) override;
     vec3 getLightPosition() override;
+    mesh const* getMesh() const override {return &cristal;}
 };
 
 class cristal_rock: public cristal{
@@ -67,8 +77,9 @@ public:
 
 
     void initialize() override;
-    void addCollisions(collision_partition *partition) override;
+    void addCollisions(collision_partition *partition, collision_arena *arena) override;
     vec3 getLightPosition() override;
+    mesh const* getMesh() const override {return &cristal;}
 };
 class cristal_large: public cristal{
 protected:
@@ -82,8 +93,9 @@ public:
 
 
     void initialize() override;
-    void addCollisions(collision_partition *partition) override;
+    void addCollisions(collision_partition *partition, collision_arena *arena) override;
     vec3 getLightPosition() override;
+    mesh const* getMesh() const override {return &cristal;}
 };
 
 
@@ -109,4 +121,39 @@ public:
 };
 
 
-
+// Draws crystals with one instanced draw per kind of crystal mesh, instead of one draw per crystal.
+// The transform, the texture and the colour of each crystal are per instance attributes. Only the crystals in the camera view are drawn:
+// the instance buffers are uploaded again when the crystals or the set of visible crystals change.
+class cristal_renderer{
+private:
+    struct instance{
+        vec3 translation;
+        vec4 rotation; // quaternion
+        vec3 scaling;
+        float texture;
+        vec3 color;
+        float radius; // bounding sphere around translation
+    };
+    struct batch{
+        mesh const* shape = NULL;
+        float radius = 0; // bounding sphere of the mesh around its origin
+        mesh_drawable drawable;
+        std::vector<instance> instances;
+        std::vector<int> visible; // instances in the buffers
+        numarray<vec3> translations;
+        numarray<vec4> rotations;
+        numarray<vec3> scalings;
+        numarray<float> textures;
+        numarray<vec3> colors;
+        bool changed = false;
+    };
+    std::vector<batch> batches;
+    std::vector<int> visible; // scratch list of the visible instances of a batch
+    void upload(batch &b);
+public:
+    void add(cristal const& c); // Crystal already initialized and updated, its current state is copied
+    void clear(); // Remove every crystal (the buffers are kept for the next ones)
+    int size() const;
+    int drawCalls() const;
+    void draw(environment_structure const& environment);
+};
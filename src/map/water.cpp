@@ -1,5 +1,9 @@
 #include "water.hpp"
 #include "../utils/math.hpp"
+#include "../utils/fractal_noise.hpp"
+#include "../utils/tangent_space.hpp"
+#include "../utils/gpu_buffer.hpp"
+#include "../utils/asset_registry.hpp"
 
 
 water::water()
@@ -26,7 +30,7 @@ void water::initialize(){
     update_terrain();
 
 
-    cmeshd.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_comp.png",
+    cmeshd.texture = asset_registry::get_texture(project::path + "assets/rock_face_comp.png",
             GL_REPEAT,
             GL_REPEAT);
     //glEnableVertexAttribArray(2); // Tangent
@@ -35,10 +39,14 @@ void water::initialize(){
     //glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, bitangent));
     cmeshd.shader.load(project::path + "shaders/normal_map/mesh_normal.vert.glsl", project::path + "shaders/normal_map/mesh_normal.frag.glsl");
     cmeshd_ground.shader.load(project::path + "shaders/normal_map/mesh_normal.vert.glsl", project::path + "shaders/normal_map/mesh_normal.frag.glsl");
-    cmeshd_ground.texture.load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_comp.png",
+    environment_structure::bind_lights(cmeshd.shader);
+    environment_structure::bind_lights(cmeshd_ground.shader);
+    render_queue::add_prepass_shader(cmeshd.shader);
+    render_queue::add_prepass_shader(cmeshd_ground.shader);
+    cmeshd_ground.texture = asset_registry::get_texture(project::path + "assets/rock_face_comp.png",
             GL_REPEAT,
             GL_REPEAT);
-    cmeshd_ground.supplementary_texture["image_texture_2"].load_and_initialize_texture_2d_on_gpu(project::path + "assets/rock_face_normal_comp.png");
+    cmeshd_ground.supplementary_texture["image_texture_2"] = asset_registry::get_texture(project::path + "assets/rock_face_normal_comp.png");
 
     cmeshd.material.phong.specular *= 0.2;
     cmeshd.material.phong.specular_exponent = 10;
@@ -49,9 +57,9 @@ void water::initialize(){
     cmeshd_ground.material.phong.diffuse *= 0.6;
 }
 
-void water::draw(environment_structure environment){
-    cgp::draw(cmeshd,environment);
-    cgp::draw(cmeshd_ground,environment);
+void water::draw(environment_structure const& environment){
+    environment.draw(cmeshd);
+    environment.draw(cmeshd_ground);
 
 }
 
@@ -67,18 +75,24 @@ void water::update_terrain()
     numarray<vec3> tangents_ground;
     numarray<vec3> bitangents_ground;
 
-    // Recompute the new vertices
+    // Recompute the new vertices, the noise of a row being evaluated at once
+    numarray<vec2> coordinates;
+    numarray<float> noise_row;
     for (int ku = 0; ku < N; ++ku) {
+        coordinates.resize(N);
+        for (int kv = 0; kv < N; ++kv) {
+            coordinates[kv] = {ku/(N-1.0f), length*(kv/(N-1.0f))/2};
+        }
+        fractal_noise::perlin(coordinates, noise_row, octave, persistency, frequency_gain);
+
         for (int kv = 0; kv < N; ++kv) {
 
             // Compute local parametric coordinates (u,v) \in [0,1]
             const float u = ku/(N-1.0f);
-            const float v = kv/(N-1.0f);
 
             int const idx = ku*N+kv;
 
-            // Compute the Perlin noise
-            float const noise = noise_perlin({u, length*v/2}, octave, persistency, frequency_gain);
+            float const noise = noise_row[kv];
 
             // use the noise as height value
             float dr = terrain_height*noise;
@@ -86,8 +100,6 @@ void water::update_terrain()
             cmesh.position[idx].z = scaling*def_r*r*(1+dr)*sin(1.4*Pi*u-0.2*Pi);
             cmesh.position[idx].x = scaling*r*(1+dr)*cos(1.4*Pi*u-0.2*Pi);
 
-            tangents.push_back({0,1,0});
-            bitangents.push_back({1,0,0});
 
             // use also the noise as color value
             //cmesh.color[idx] = vec3(0,0.5f,0)*0.3f+0.7f*noise*vec3(1,1,1);
@@ -96,20 +108,23 @@ void water::update_terrain()
 
     // Do the same for ground
     for (int ku = 0; ku < N_ground; ++ku) {
+        coordinates.resize(N_ground);
+        for (int kv = 0; kv < N_ground; ++kv) {
+            coordinates[kv] = {ku/(N_ground-1.0f), length*(kv/(N_ground-1.0f))};
+        }
+        fractal_noise::perlin(coordinates, noise_row, octave_ground, persistency_ground, frequency_gain_ground);
+
         for (int kv = 0; kv < N_ground; ++kv) {
             const float u = ku/(N_ground-1.0f);
-            const float v = kv/(N_ground-1.0f);
 
             int const idx = ku*N_ground+kv;
 
-            float const noise = noise_perlin({u, length*v}, octave_ground, persistency_ground, frequency_gain_ground);
+            float const noise = noise_row[kv];
 
             // use the noise as height value
             float dr = terrain_height_ground*noise;
             cmesh_ground.position[idx].z = dr+0*pow(u-0.5,2) + pow(u-0.5,2)/r;
             //cmesh_ground.position[idx].z = 0;
-            tangents_ground.push_back({0,1,0});
-            bitangents_ground.push_back({1,0,0});
         }
     }
 
@@ -118,80 +133,22 @@ void water::update_terrain()
     cmesh_ground.normal_update();
 
 
-    for (int ku = 0; ku < N; ++ku) {
-        for (int kv = 0; kv < N; ++kv) {
-            int const idx = ku*N+kv;
-            cmesh.normal[idx] *= -1;
-            int idx2;
-            int idx3;
-
-            if(ku==N-1 && kv==N-1){
-                idx2 = (ku-1)*N+kv-1;
-                idx3 = (ku-1)*N+kv;
-            }
-            else if(ku==N-1){
-                idx2 = ku*N+kv+1;
-                idx3 = (ku-1)*N+kv;
-            }
-            else if(kv==N-1){
-                idx2 = ku*N+kv-1;
-                idx3 = (ku+1)*N+kv;
-            }
-            else{
-                idx2 = (ku+1)*N+kv;
-                idx3 = (ku+1)*N+kv+1;
-            }
-
-            tangents[idx] = math::calculate_tangent(cmesh.position[idx],cmesh.position[idx2],cmesh.position[idx3],cmesh.uv[idx],cmesh.uv[idx2],cmesh.uv[idx3],cmesh.normal[idx]);
-            bitangents[idx] = math::calculate_bitangent(tangents[idx],cmesh.normal[idx]);
-        }
-    }
-
-    for (int ku = 0; ku < N_ground; ++ku) {
-        for (int kv = 0; kv < N_ground; ++kv) {
-            int const idx = ku*N_ground+kv;
-
-            int idx2;
-            int idx3;
-
-            if(ku==N_ground-1 && kv==N_ground-1){
-                idx2 = (ku-1)*N_ground+kv-1;
-                idx3 = (ku-1)*N_ground+kv;
-            }
-            else if(ku==N_ground-1){
-                idx2 = ku*N_ground+kv+1;
-                idx3 = (ku-1)*N_ground+kv;
-            }
-            else if(kv==N_ground-1){
-                idx2 = ku*N_ground+kv-1;
-                idx3 = (ku+1)*N_ground+kv;
-            }
-            else{
-                idx2 = (ku+1)*N_ground+kv;
-                idx3 = (ku+1)*N_ground+kv+1;
-            }
-
-            tangents_ground[idx] = math::calculate_tangent(cmesh_ground.position[idx],cmesh_ground.position[idx2],cmesh_ground.position[idx3],cmesh_ground.uv[idx],cmesh_ground.uv[idx2],cmesh_ground.uv[idx3],cmesh_ground.normal[idx]);
-            bitangents_ground[idx] = math::calculate_bitangent(tangents_ground[idx],cmesh_ground.normal[idx]);
-        }
+    // The arch is seen from the inside
+    for (int idx = 0; idx < cmesh.normal.size(); ++idx) {
+        cmesh.normal[idx] *= -1;
     }
 
+    tangent_space::compute(cmesh,tangents,bitangents);
+    tangent_space::compute(cmesh_ground,tangents_ground,bitangents_ground);
 
+    // Update step: the buffers are overwritten in place, the tangents are created on the first call only
+    gpu_buffer::update(cmeshd.vbo_position, cmesh.position);
+    gpu_buffer::update(cmeshd.vbo_normal, cmesh.normal);
+    gpu_buffer::attribute(cmeshd, 0, tangents, 4);
+    gpu_buffer::attribute(cmeshd, 1, bitangents, 5);
 
-    // Update step: Allows to update a mesh_drawable without creating a new one
-    cmeshd.vbo_position.update(cmesh.position);
-    cmeshd.vbo_normal.update(cmesh.normal);
-    cmeshd.vbo_color.update(cmesh.color);
-    cmeshd.initialize_supplementary_data_on_gpu(tangents,4);
-    cmeshd.initialize_supplementary_data_on_gpu(bitangents,5);
-    cmeshd_ground.initialize_supplementary_data_on_gpu(tangents_ground,4);
-    cmeshd_ground.initialize_supplementary_data_on_gpu(bitangents_ground,5);
-    //cmeshd.supplementary_vbo.push_back(tangents_vbo);
-    //cmeshd.supplementary_vbo.push_back(bitangents_vbo);
-
-
-    cmeshd_ground.vbo_position.update(cmesh_ground.position);
-    cmeshd_ground.vbo_normal.update(cmesh_ground.normal);
-    cmeshd_ground.vbo_color.update(cmesh_ground.color);
-
+    gpu_buffer::update(cmeshd_ground.vbo_position, cmesh_ground.position);
+    gpu_buffer::update(cmeshd_ground.vbo_normal, cmesh_ground.normal);
+    gpu_buffer::attribute(cmeshd_ground, 0, tangents_ground, 4);
+    gpu_buffer::attribute(cmeshd_ground, 1, bitangents_ground, 5);
 }
\ No newline at end of file
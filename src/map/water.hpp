@@ -39,7 +39,7 @@ public:
     float length = 2;
 
     void initialize();
-    void draw(environment_structure environment);
+    void draw(environment_structure const& environment);
     void update_terrain();
 };
 
@@ -4,6 +4,7 @@
 using namespace cgp;
 
 #include "utils/math.hpp"
+#include "utils/fractal_noise.hpp"
 
 #include "subscene/test_scene.hpp"
 
@@ -26,6 +27,10 @@ void scene_structure::initialize()
 		{0,0,1} /* direction of the "up" vector */);
 
 	environment.fog_color = {0,0,0};
+	environment.timings = &timings;
+	timings.export_path = project::path + "profile.csv";
+	// The vectorised noise of the terrain generation must give the values of cgp::noise_perlin
+	fractal_noise::self_test();
 
 	// Display general information
 	display_info();
@@ -36,6 +41,15 @@ void scene_structure::initialize()
     
 
 
+	// Load the files of the scene in parallel, the initialize() functions then find them in the asset_registry
+	// ********************************************** //
+    asset_loader loader;
+    Spider.addAssets(loader);
+    cave::addAssets(loader);
+    loader.load([](int loaded, int total, std::string const& path){
+        std::cout << "Loading assets " << loaded << "/" << total << " : " << path << std::endl;
+    });
+
 	// Create the shapes seen in the 3D scene
 	// ********************************************** //
     Spider.initialize();
@@ -49,6 +63,10 @@ void scene_structure::initialize()
 // Note that you should avoid having costly computation and large allocation defined there. This function is mostly used to call the draw() functions on pre-existing data.
 void scene_structure::display_frame()
 {
+	timings.next_frame();
+	profiler::scope frame_section(&timings, "frame");
+
+	environment.view_frustum.update(environment.camera_projection, environment.camera_view);
 
 	// Set the light to the current position of the camera
 	environment.light = {0,0,0.5};//camera_control.camera_model.position();
@@ -68,9 +86,22 @@ void scene_structure::display_frame()
     if(gui.selected_scene==0){
         environment.has_fog = true;
         environment.fog_distance = 7;
-        SpiderCtrl.update(&Cave);
+        {
+            profiler::scope section(&timings, "update");
+            Cave.update(Spider.translation);
+            SpiderCtrl.update(&Cave);
+        }
+        Cave.add_lights(environment);
+        {
+            profiler::scope section(&timings, "lights");
+            environment.send_lights();
+        }
+        environment.queue = &draw_queue;
         Cave.draw(environment);
         Spider.draw(environment);
+        environment.queue = NULL;
+        profiler::scope section(&timings, "draw queue");
+        draw_queue.draw(environment);
     }
     else if(gui.selected_scene==1){
         testing_scene.display_frame(environment);
@@ -116,10 +147,23 @@ void scene_structure::display_gui()
         	ImGui::SliderInt("Cartoon levels",&gui.cartoon_levels,1,20);
 		}*/
         SpiderCtrl.display_gui();
+        Cave.display_gui();
     }
     else if(gui.selected_scene==1){
         testing_scene.display_gui();
     }
+    ImGui::Checkbox("Frustum culling", &environment.view_frustum.enabled);
+    ImGui::Text("Culled objects: %d / %d", environment.view_frustum.culled(), environment.view_frustum.tested());
+    ImGui::Checkbox("Profiler", &timings.enabled);
+    timings.display_gui();
+    if(gui.selected_scene==0){
+        ImGui::Checkbox("Sort draw calls", &draw_queue.sorting);
+        ImGui::Text("Draw calls: %d, state changes: %d", draw_queue.draw_calls(), draw_queue.state_changes());
+        ImGui::Checkbox("Depth pre-pass", &draw_queue.depth_prepass);
+        if(gpu_timer::supported()){
+            ImGui::Text("GPU time of the draws: %.2f ms", draw_queue.gpu_milliseconds());
+        }
+    }
 
 }
 
@@ -48,6 +48,8 @@ struct scene_structure : cgp::scene_inputs_generic {
 	window_structure window;
 
 	environment_structure environment;   // Standard environment controler
+	render_queue draw_queue;             // Draws of the cave scene, sorted by state
+	profiler timings;                    // CPU and GPU time of the parts of the frame
 	input_devices inputs;                // Storage for inputs status (mouse, keyboard, window dimension)
 	gui_parameters gui;                  // Standard GUI element storage
 	
@@ -101,7 +101,20 @@ void test_scene::initialize(input_devices& _inputs, window_structure& window){
 }
 
 void test_scene::display_frame(environment_structure &environment) {
+    // The lights of the frame are gathered first and sent once
     environment.multiLight = false;
+    if((gui.selected_scene==3 && gui.show_cave) || gui.selected_scene==4 || gui.selected_scene==5){
+        cave_obj.add_lights(environment);
+    }
+    if(gui.selected_scene==5){
+        vec3 deco_pos_rot_memory = col_positions_decorator.key_positions[1] - cristal_decorator.translation;
+        cristal_decorator.translation = col_positions_decorator.key_positions[0];
+        col_positions_decorator.key_positions[1] = cristal_decorator.translation + deco_pos_rot_memory;
+        if(gui.show_decorator){
+            environment.lights.push_back(cristal_decorator.getLightParams());
+        }
+    }
+    environment.send_lights();
     environment.has_fog = false;
     timer.update();
     environment.time = timer.t;
@@ -244,12 +257,8 @@ void test_scene::display_frame(environment_structure &environment) {
         SpiderCtrl.debug_draw(environment);
     }
     else if(gui.selected_scene==5){
-        vec3 deco_pos_rot_memory = col_positions_decorator.key_positions[1] - cristal_decorator.translation;
-        cristal_decorator.translation = col_positions_decorator.key_positions[0];
-        col_positions_decorator.key_positions[1] = cristal_decorator.translation + deco_pos_rot_memory;
         col_positions_decorator.display_key_positions(environment);
         if(gui.show_decorator){
-            environment.lights.push_back(cristal_decorator.getLightParams());
             cristal_decorator.rotation = rotation_transform::from_vector_transform({0,0,1},normalize(col_positions_decorator.key_positions[1]-col_positions_decorator.key_positions[0]));
             cristal_decorator.rotation = cristal_decorator.rotation * rotation_transform::from_axis_angle({0,0,1},deco_z_rot);
             cristal_decorator.update();
@@ -0,0 +1,155 @@
+#include "asset_loader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "asset_registry.hpp"
+#include "mesh_binary.hpp"
+#include "parallel.hpp"
+
+using namespace cgp;
+
+
+// Size of the file read for this path, 0 if it does not exist
+static long long file_size(std::string const& path)
+{
+    struct stat status;
+    if(stat(path.c_str(),&status)!=0){
+        return 0;
+    }
+    return status.st_size;
+}
+
+void asset_loader::add_mesh(std::string const& path, bool tangents)
+{
+    for(asset &a : assets){
+        if(a.is_mesh && a.path==path){
+            a.tangents = a.tangents || tangents;
+            return;
+        }
+    }
+    assets.push_back({path, true, tangents, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE});
+}
+
+void asset_loader::add_texture(std::string const& path, GLint wrap_s, GLint wrap_t)
+{
+    for(asset const& a : assets){
+        if(!a.is_mesh && a.path==path && a.wrap_s==wrap_s && a.wrap_t==wrap_t){
+            return;
+        }
+    }
+    assets.push_back({path, false, false, wrap_s, wrap_t});
+}
+
+int asset_loader::size() const
+{
+    return assets.size();
+}
+
+void asset_loader::decode(asset const& a)
+{
+    if(a.is_mesh){
+        if(a.tangents){
+            asset_registry::get_tangents(a.path);
+        }
+        else{
+            asset_registry::get_mesh(a.path);
+        }
+    }
+    else{
+        asset_registry::load_image(a.path);
+    }
+}
+
+void asset_loader::upload(asset const& a)
+{
+    if(a.is_mesh){
+        asset_registry::get_drawable(a.path);
+    }
+    else{
+        asset_registry::get_texture(a.path, a.wrap_s, a.wrap_t);
+    }
+}
+
+void asset_loader::load(progress_callback const& progress)
+{
+    int const N = assets.size();
+    if(N==0){
+        return;
+    }
+
+    // Largest files first, so that the slowest asset does not start last
+    std::vector<long long> sizes(N);
+    for(int k=0;k<N;k++){
+        std::string const binary = mesh_binary::binary_path(assets[k].path);
+        sizes[k] = assets[k].is_mesh && file_size(binary)>0 ? file_size(binary) : file_size(assets[k].path);
+    }
+    std::vector<int> order(N);
+    for(int k=0;k<N;k++){
+        order[k] = k;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sizes](int a, int b){ return sizes[a]>sizes[b]; });
+
+    int const threads = std::min(parallel::thread_count(),N);
+    if(threads<=1){
+        for(int k=0;k<N;k++){
+            asset const& a = assets[order[k]];
+            decode(a);
+            upload(a);
+            if(progress){
+                progress(k+1, N, a.path);
+            }
+        }
+        assets.clear();
+        return;
+    }
+
+    // The workers decode the assets one after the other and queue them, the calling thread uploads them
+    std::atomic<int> next(0);
+    std::vector<int> decoded;
+    std::mutex decoded_mutex;
+    std::condition_variable decoded_signal;
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for(int t=0;t<threads;t++){
+        workers.push_back(std::thread([&](){
+            for(int k=next++; k<N; k=next++){
+                decode(assets[order[k]]);
+                {
+                    std::lock_guard<std::mutex> lock(decoded_mutex);
+                    decoded.push_back(order[k]);
+                }
+                decoded_signal.notify_one();
+            }
+        }));
+    }
+
+    int loaded = 0;
+    std::vector<int> ready;
+    while(loaded<N){
+        {
+            std::unique_lock<std::mutex> lock(decoded_mutex);
+            decoded_signal.wait(lock, [&decoded](){ return !decoded.empty(); });
+            ready.swap(decoded);
+        }
+        for(int index : ready){
+            upload(assets[index]);
+            loaded++;
+            if(progress){
+                progress(loaded, N, assets[index].path);
+            }
+        }
+        ready.clear();
+    }
+
+    for(auto &worker : workers){
+        worker.join();
+    }
+    assets.clear();
+}
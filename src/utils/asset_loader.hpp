@@ -0,0 +1,41 @@
+#ifndef ASSET_LOADER_HPP
+#define ASSET_LOADER_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+
+// Loads a list of meshes and textures before the objects using them are initialized.
+// The files are read and decoded (and the tangent frames computed) on worker threads, while the calling thread uploads
+// each asset to the GPU as soon as it is ready: the loading time is the one of the slowest asset rather than the sum of all of them.
+// Everything goes through asset_registry, where the initialize() functions then find the assets already loaded.
+class asset_loader
+{
+    public:
+        // Called on the calling thread after each upload
+        typedef std::function<void(int loaded, int total, std::string const& path)> progress_callback;
+
+        void add_mesh(std::string const& path, bool tangents = false);
+        void add_texture(std::string const& path, GLint wrap_s = GL_CLAMP_TO_EDGE, GLint wrap_t = GL_CLAMP_TO_EDGE);
+
+        // Load every asset added so far. Must be called from the OpenGL thread
+        void load(progress_callback const& progress = progress_callback());
+        int size() const;
+
+    private:
+        struct asset{
+            std::string path;
+            bool is_mesh;
+            bool tangents;
+            GLint wrap_s;
+            GLint wrap_t;
+        };
+        std::vector<asset> assets;
+
+        static void decode(asset const& a);
+        static void upload(asset const& a);
+};
+
+#endif // ASSET_LOADER_HPP
@@ -0,0 +1,146 @@
+#include "asset_registry.hpp"
+
+#include <map>
+#include <mutex>
+
+#include "mesh_binary.hpp"
+#include "tangent_space.hpp"
+
+using namespace cgp;
+
+
+namespace asset_registry
+{
+    struct mesh_asset{
+        mesh shape;
+        numarray<vec3> tangents;
+        numarray<vec3> bitangents;
+        // Loaded outside of the registry lock, so that several files are loaded at the same time
+        std::once_flag shape_loaded;
+        std::once_flag tangents_computed;
+    };
+
+    // std::map keeps the references valid when other entries are added
+    static std::map<std::string, mesh_asset> meshes;
+    static std::map<std::string, mesh_drawable> drawables;
+    static std::mutex meshes_mutex;
+
+    static std::map<std::string, image_structure> images;
+    static std::map<std::string, opengl_texture_image_structure> textures;
+    static std::mutex images_mutex;
+
+    static mesh_asset& get_asset(std::string const& path)
+    {
+        mesh_asset *asset = NULL;
+        {
+            std::lock_guard<std::mutex> lock(meshes_mutex);
+            asset = &meshes[path];
+        }
+        std::call_once(asset->shape_loaded, [asset,&path](){
+            mesh_binary::load_mesh(path, asset->shape, asset->tangents, asset->bitangents);
+        });
+        return *asset;
+    }
+
+    mesh const& get_mesh(std::string const& path)
+    {
+        return get_asset(path).shape;
+    }
+
+    static mesh_asset& get_tangent_space(std::string const& path)
+    {
+        mesh_asset &asset = get_asset(path);
+        std::call_once(asset.tangents_computed, [&asset](){
+            if(asset.tangents.size()!=asset.shape.position.size()){
+                asset.shape.fill_empty_field();
+                tangent_space::compute(asset.shape, asset.tangents, asset.bitangents);
+            }
+        });
+        return asset;
+    }
+
+    numarray<vec3> const& get_tangents(std::string const& path)
+    {
+        return get_tangent_space(path).tangents;
+    }
+
+    numarray<vec3> const& get_bitangents(std::string const& path)
+    {
+        return get_tangent_space(path).bitangents;
+    }
+
+    mesh_drawable& get_drawable(std::string const& path)
+    {
+        auto found = drawables.find(path);
+        if(found!=drawables.end()){
+            return found->second;
+        }
+        mesh_drawable &drawable = drawables[path];
+        drawable.initialize_data_on_gpu(get_mesh(path));
+        return drawable;
+    }
+
+    void load_image(std::string const& path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(images_mutex);
+            if(images.find(path)!=images.end()){
+                return;
+            }
+        }
+        // Decoded outside of the lock so that several images are decoded at the same time
+        image_structure image = image_load_file(path);
+        std::lock_guard<std::mutex> lock(images_mutex);
+        images[path] = std::move(image);
+    }
+
+    opengl_texture_image_structure get_texture(std::string const& path, GLint wrap_s, GLint wrap_t)
+    {
+        std::string const key = path+"|"+std::to_string(wrap_s)+"|"+std::to_string(wrap_t);
+        auto found = textures.find(key);
+        if(found!=textures.end()){
+            return found->second;
+        }
+        load_image(path);
+        std::lock_guard<std::mutex> lock(images_mutex);
+        opengl_texture_image_structure &texture = textures[key];
+        texture.initialize_texture_2d_on_gpu(images[path], wrap_s, wrap_t);
+        // Not needed on the CPU anymore (decoded again if the image is asked with other wrapping modes)
+        images.erase(path);
+        return texture;
+    }
+
+    int loaded_meshes()
+    {
+        std::lock_guard<std::mutex> lock(meshes_mutex);
+        return meshes.size();
+    }
+
+    int uploaded_drawables()
+    {
+        return drawables.size();
+    }
+
+    int uploaded_textures()
+    {
+        return textures.size();
+    }
+
+    void clear()
+    {
+        for(auto &entry : drawables){
+            entry.second.clear();
+        }
+        drawables.clear();
+        for(auto &entry : textures){
+            glDeleteTextures(1, &entry.second.id);
+        }
+        textures.clear();
+        {
+            std::lock_guard<std::mutex> lock(images_mutex);
+            images.clear();
+        }
+        std::lock_guard<std::mutex> lock(meshes_mutex);
+        meshes.clear();
+    }
+}
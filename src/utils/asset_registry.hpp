@@ -0,0 +1,34 @@
+#ifndef ASSET_REGISTRY_HPP
+#define ASSET_REGISTRY_HPP
+
+#include <string>
+
+#include "cgp/cgp.hpp"
+
+// Meshes and textures loaded from files, shared by every object of the program.
+// Each file is loaded once (meshes from their binary version when it exists, see mesh_binary), and uploaded to the GPU once:
+// a mesh_drawable copied from get_drawable() uses the same buffers (its model, material, textures and shader can still be changed independently).
+// The CPU side (get_mesh, get_tangents, load_image) can be called from any thread, see asset_loader.
+namespace asset_registry
+{
+    // Parsed mesh of an OBJ file, loaded on the first call. Can be called from any thread
+    cgp::mesh const& get_mesh(std::string const& path);
+    // Tangent frames of the mesh: precomputed in the binary file, computed on the first call otherwise
+    cgp::numarray<cgp::vec3> const& get_tangents(std::string const& path);
+    cgp::numarray<cgp::vec3> const& get_bitangents(std::string const& path);
+    // Drawable of the mesh, uploaded on the first call. OpenGL thread only.
+    // Supplementary buffers added to the returned reference are shared as well.
+    cgp::mesh_drawable& get_drawable(std::string const& path);
+
+    // Decode the image file, without uploading it. Can be called from any thread
+    void load_image(std::string const& path);
+    // Texture of the image, uploaded on the first call with these wrapping modes (the decoded image is then released). OpenGL thread only.
+    cgp::opengl_texture_image_structure get_texture(std::string const& path, GLint wrap_s = GL_CLAMP_TO_EDGE, GLint wrap_t = GL_CLAMP_TO_EDGE);
+
+    int loaded_meshes();
+    int uploaded_drawables();
+    int uploaded_textures();
+    void clear(); // Release every mesh, image and every GPU buffer
+}
+
+#endif // ASSET_REGISTRY_HPP
@@ -0,0 +1,90 @@
+#include "binary_cache.hpp"
+
+#include <cstdio>
+
+#include "../environment.hpp"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+namespace binary_cache
+{
+    static char const magic[4] = {'C','B','I','N'};
+
+    uint64_t hash(void const* data, size_t size, uint64_t seed)
+    {
+        unsigned char const* bytes = static_cast<unsigned char const*>(data);
+        uint64_t h = seed;
+        for(size_t k=0;k<size;k++){
+            h ^= bytes[k];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+
+    std::string path(std::string const& name, uint64_t key)
+    {
+        std::string const directory = project::path + "cache/";
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+        return directory + name + "_" + hex + ".bin";
+    }
+
+    bool writer::open(std::string const& _file_path, uint64_t key)
+    {
+        // Written under a temporary name, so that an interrupted write never leaves a valid looking cache
+        file_path = _file_path;
+        stream.open(file_path+".tmp", std::ios::binary | std::ios::trunc);
+        if(!stream){
+            return false;
+        }
+        stream.write(magic, sizeof(magic));
+        stream.write(reinterpret_cast<char const*>(&version), sizeof(version));
+        stream.write(reinterpret_cast<char const*>(&key), sizeof(key));
+        return bool(stream);
+    }
+
+    bool writer::close()
+    {
+        bool const success = bool(stream);
+        stream.close();
+        if(!success){
+            std::remove((file_path+".tmp").c_str());
+            return false;
+        }
+        std::remove(file_path.c_str());
+        return std::rename((file_path+".tmp").c_str(), file_path.c_str())==0;
+    }
+
+    bool reader::open(std::string const& file_path, uint64_t key)
+    {
+        valid = false;
+        offset = 0;
+        if(!file.open(file_path)){
+            return false;
+        }
+        size_t const header = sizeof(magic)+sizeof(version)+sizeof(key);
+        if(file.size()<header){
+            return false;
+        }
+        uint32_t file_version;
+        uint64_t file_key;
+        std::memcpy(&file_version, file.data()+sizeof(magic), sizeof(file_version));
+        std::memcpy(&file_key, file.data()+sizeof(magic)+sizeof(version), sizeof(file_key));
+        if(std::memcmp(file.data(), magic, sizeof(magic))!=0 || file_version!=version || file_key!=key){
+            return false;
+        }
+        offset = header;
+        valid = true;
+        return true;
+    }
+}
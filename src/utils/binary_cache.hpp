@@ -0,0 +1,73 @@
+#ifndef BINARY_CACHE_HPP
+#define BINARY_CACHE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#include "cgp/cgp.hpp"
+#include "mapped_file.hpp"
+
+// Binary cache of generated data (numarrays of plain values), identified by a key built from every parameter of the generation.
+// A file is only read back if its key and its format version match, otherwise the data has to be generated again.
+namespace binary_cache
+{
+    uint32_t const version = 1;
+
+    // FNV-1a hash, seed allows to chain several calls
+    uint64_t hash(void const* data, size_t size, uint64_t seed = 14695981039346656037ull);
+
+    // Cache file of a key in the cache directory of the project (created if needed)
+    std::string path(std::string const& name, uint64_t key);
+
+    class writer
+    {
+    private:
+        std::ofstream stream;
+        std::string file_path;
+    public:
+        bool open(std::string const& _file_path, uint64_t key);
+        template <typename T>
+        void write(cgp::numarray<T> const& data){
+            uint64_t const count = data.size();
+            uint32_t const element = sizeof(T);
+            stream.write(reinterpret_cast<char const*>(&count), sizeof(count));
+            stream.write(reinterpret_cast<char const*>(&element), sizeof(element));
+            if(count>0){
+                stream.write(reinterpret_cast<char const*>(&data[0]), count*sizeof(T));
+            }
+        }
+        bool close(); // false (and no file left) if something could not be written
+    };
+
+    class reader
+    {
+    private:
+        mapped_file file;
+        size_t offset = 0;
+        bool valid = false;
+    public:
+        bool open(std::string const& file_path, uint64_t key); // false if there is no valid cache for this key
+        // Copy the next array out of the mapped file, false if the file is truncated or does not match T
+        template <typename T>
+        bool read(cgp::numarray<T> &data){
+            uint64_t count = 0;
+            uint32_t element = 0;
+            if(!valid || offset+sizeof(count)+sizeof(element)>file.size()){return valid = false;}
+            std::memcpy(&count, file.data()+offset, sizeof(count));
+            std::memcpy(&element, file.data()+offset+sizeof(count), sizeof(element));
+            offset += sizeof(count)+sizeof(element);
+            if(element!=sizeof(T) || count>(file.size()-offset)/sizeof(T)){return valid = false;}
+            data.resize(count);
+            if(count>0){
+                std::memcpy(&data[0], file.data()+offset, count*sizeof(T));
+            }
+            offset += count*sizeof(T);
+            return true;
+        }
+        void close(){file.close(); valid = false;}
+    };
+}
+
+#endif // BINARY_CACHE_HPP
@@ -0,0 +1,37 @@
+#include "collision_arena.hpp"
+
+#include <new>
+
+
+collision_arena::collision_arena(size_t _chunk_size){
+    chunk_size = _chunk_size;
+}
+
+collision_arena::~collision_arena(){
+    clear();
+}
+
+void* collision_arena::allocate(size_t size, size_t alignment){
+    size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+    if(chunks.empty() || aligned + size > chunk_sizes.back()){
+        size_t new_chunk_size = (size > chunk_size) ? size : chunk_size;
+        chunks.push_back(static_cast<char*>(::operator new(new_chunk_size)));
+        chunk_sizes.push_back(new_chunk_size);
+        aligned = 0;
+    }
+    offset = aligned + size;
+    return chunks.back() + aligned;
+}
+
+void collision_arena::clear(){
+    for(auto object : objects){
+        object->~collision_object();
+    }
+    objects.clear();
+    for(auto chunk : chunks){
+        ::operator delete(chunk);
+    }
+    chunks.clear();
+    chunk_sizes.clear();
+    offset = 0;
+}
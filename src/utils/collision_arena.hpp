@@ -0,0 +1,49 @@
+#ifndef COLLISION_ARENA_HPP
+#define COLLISION_ARENA_HPP
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+#include "collision_object.hpp"
+
+// Monotonic arena owning the static collision primitives of a level.
+// Objects are placed one after the other inside large chunks (one allocation per chunk),
+// they are never freed individually: everything is released at once by clear() or on destruction.
+class collision_arena
+{
+private:
+    std::vector<char*> chunks;
+    std::vector<size_t> chunk_sizes; // a chunk is larger than chunk_size when it holds a single larger object
+    std::vector<collision_object*> objects; // kept for the destructor calls only
+    size_t chunk_size;
+    size_t offset = 0; // position of the next object in the last chunk
+
+    void* allocate(size_t size, size_t alignment);
+
+public:
+    collision_arena(size_t _chunk_size = 1<<20);
+    ~collision_arena();
+
+    collision_arena(collision_arena const&) = delete;
+    collision_arena& operator=(collision_arena const&) = delete;
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args){
+        T* object = new (allocate(sizeof(T),alignof(T))) T(std::forward<Args>(args)...);
+        objects.push_back(object);
+        return object;
+    }
+
+    void reserve(size_t number_objects){objects.reserve(number_objects);}
+    void clear();
+
+    size_t size(){return objects.size();}
+    size_t allocated_bytes(){
+        size_t total = 0;
+        for(size_t bytes : chunk_sizes){total += bytes;}
+        return total;
+    }
+};
+
+#endif // COLLISION_ARENA_HPP
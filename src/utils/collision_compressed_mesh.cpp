@@ -0,0 +1,175 @@
+#include "collision_compressed_mesh.hpp"
+
+#include <algorithm>
+
+#include "math.hpp"
+
+
+using namespace cgp;
+
+
+collision_compressed_mesh::collision_compressed_mesh(collision_partition *_partition): collision_cell_mesh(_partition){
+    color = {0,0.7,1};
+}
+
+void collision_compressed_mesh::add_triangles(numarray<vec3> const& positions, numarray<uint3> const& triangles){
+    for(int i=0;i<triangles.size();i++){
+        uint3 const& triangle = triangles[i];
+        vec3 const& p0 = positions[triangle[0]];
+        numarray<partition_coordinates> Cs = get_triangle_boxes(p0,positions[triangle[1]]-p0,positions[triangle[2]]-p0,partition);
+        for(auto C : Cs){
+            int idx = partition->get_index(C);
+            auto last = last_pending.find(idx);
+            int current;
+            if(last==last_pending.end()){
+                current = pending.size();
+                pending.push_back(pending_cell());
+                pending[current].coordinates = (idx>=0) ? C : partition->get_out_coordinates();
+                first_cell[idx] = current;
+                last_pending[idx] = current;
+            }
+            else{
+                current = last->second;
+                // Local indices are 16 bits, chain a new cell when this one cannot hold 3 more vertices
+                if(pending[current].vertices.size() > 65536-3){
+                    int next = pending.size();
+                    pending.push_back(pending_cell());
+                    pending[next].coordinates = pending[current].coordinates;
+                    pending[current].next = next;
+                    last_pending[idx] = next;
+                    current = next;
+                }
+            }
+
+            pending_cell &target = pending[current];
+            for(int k=0;k<3;k++){
+                unsigned int global_index = vertex_offset + triangle[k];
+                auto found = target.local_index.find(global_index);
+                if(found==target.local_index.end()){
+                    uint16_t local = target.vertices.size();
+                    target.local_index[global_index] = local;
+                    target.vertices.push_back(positions[triangle[k]]);
+                    target.indices.push_back(local);
+                }
+                else{
+                    target.indices.push_back(found->second);
+                }
+            }
+        }
+        triangle_count++;
+    }
+    vertex_offset += positions.size();
+}
+
+void collision_compressed_mesh::add_triangles(collision_mesh const& shared){
+    numarray<vec3> positions;
+    positions.resize(shared.get_source()->position.size());
+    for(int idx=0;idx<positions.size();idx++){
+        positions[idx] = shared.get_world_position(idx);
+    }
+    add_triangles(positions,shared.get_source()->connectivity);
+}
+
+void collision_compressed_mesh::compress(){
+    cells.resize(pending.size());
+    for(int i=0;i<pending.size();i++){
+        pending_cell &source = pending[i];
+        cell &target = cells[i];
+        target.coordinates = source.coordinates;
+        target.next = source.next;
+
+        vec3 p_min = source.vertices[0];
+        vec3 p_max = source.vertices[0];
+        for(auto const& p : source.vertices){
+            for(int k=0;k<3;k++){
+                p_min[k] = std::min(p_min[k],p[k]);
+                p_max[k] = std::max(p_max[k],p[k]);
+            }
+        }
+        target.origin = p_min;
+        target.step = (p_max-p_min)/65535.0f;
+
+        target.vertices.resize(3*source.vertices.size());
+        for(int j=0;j<source.vertices.size();j++){
+            for(int k=0;k<3;k++){
+                float q = (target.step[k]>0) ? (source.vertices[j][k]-p_min[k])/target.step[k] : 0.0f;
+                target.vertices[3*j+k] = uint16_t(std::min(65535.0f,std::max(0.0f,std::round(q))));
+            }
+        }
+        target.indices = source.indices;
+        target.indices.shrink_to_fit();
+    }
+    pending.clear();
+    last_pending.clear();
+}
+
+void collision_compressed_mesh::clear(){
+    cells.clear();
+    first_cell.clear();
+    pending.clear();
+    last_pending.clear();
+    vertex_offset = 0;
+    triangle_count = 0;
+}
+
+size_t collision_compressed_mesh::memory_footprint(){
+    size_t bytes = sizeof(collision_compressed_mesh);
+    for(auto const& c : cells){
+        bytes += sizeof(cell) + c.vertices.capacity()*sizeof(uint16_t) + c.indices.capacity()*sizeof(uint16_t);
+    }
+    bytes += first_cell.size()*(sizeof(int)*2+sizeof(void*));
+    return bytes;
+}
+
+numarray<partition_coordinates> collision_compressed_mesh::get_boxes(collision_partition* _partition){
+    numarray<partition_coordinates> Cs;
+    if(_partition!=partition){return Cs;}
+    for(auto const& first : first_cell){
+        Cs.push_back(cells[first.second].coordinates);
+    }
+    return Cs;
+}
+
+bool collision_compressed_mesh::ray_cast_cell(int cell_index, vec3 const& start, vec3 const& director, float &min_dist, vec3 &result){
+    bool collision = false;
+    while(cell_index>=0){
+        cell const& c = cells[cell_index];
+        uint16_t const* vertices = c.vertices.data();
+        uint16_t const* indices = c.indices.data();
+        int const N = c.indices.size();
+        for(int i=0;i<N;i+=3){
+            uint16_t const* q0 = vertices + 3*indices[i];
+            uint16_t const* q1 = vertices + 3*indices[i+1];
+            uint16_t const* q2 = vertices + 3*indices[i+2];
+            vec3 p0 = {c.origin.x+c.step.x*q0[0], c.origin.y+c.step.y*q0[1], c.origin.z+c.step.z*q0[2]};
+            vec3 p1 = {c.origin.x+c.step.x*q1[0], c.origin.y+c.step.y*q1[1], c.origin.z+c.step.z*q1[2]};
+            vec3 p2 = {c.origin.x+c.step.x*q2[0], c.origin.y+c.step.y*q2[1], c.origin.z+c.step.z*q2[2]};
+            vec3 temp;
+            if(math::segment_triangle_intersection(start,director,p0,p1-p0,p2-p0,temp)){
+                float dist = norm(start-temp);
+                if(min_dist<0 || min_dist>dist){
+                    min_dist = dist;
+                    result = temp;
+                    collision = true;
+                }
+            }
+        }
+        cell_index = c.next;
+    }
+    return collision;
+}
+
+bool collision_compressed_mesh::does_collide(collision_ray* ray, numarray<partition_coordinates> const& coords, vec3 &collision_point){
+    float min_dist = -1;
+    vec3 result;
+    for(auto const& C : coords){
+        auto first = first_cell.find(partition->get_index(C));
+        if(first==first_cell.end()){continue;}
+        ray_cast_cell(first->second, ray->translation, ray->director, min_dist, result);
+    }
+    if(min_dist>=0){
+        collision_point = result;
+        return true;
+    }
+    return false;
+}
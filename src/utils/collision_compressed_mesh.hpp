@@ -0,0 +1,64 @@
+#ifndef COLLISION_COMPRESSED_MESH_HPP
+#define COLLISION_COMPRESSED_MESH_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "collision_object.hpp"
+#include "touchable_object.hpp"
+#include "collision_mesh.hpp"
+
+// Compact static triangle soup stored per partition cell.
+// In each cell the vertices are quantised to 16 bits relative to the cell bounding box,
+// and the triangles are 3 local indices in the shared vertex buffer of the cell.
+// Triangles are decoded on the fly when a ray traverses the cell.
+class collision_compressed_mesh: public collision_cell_mesh
+{
+private:
+    struct cell{
+        partition_coordinates coordinates;
+        int next = -1; // overflow cell when more than 65536 vertices land in the same partition cell
+        cgp::vec3 origin;
+        cgp::vec3 step; // size of one quantisation unit along each axis
+        std::vector<uint16_t> vertices; // x,y,z
+        std::vector<uint16_t> indices;  // 3 per triangle
+    };
+    struct pending_cell{
+        partition_coordinates coordinates;
+        int next = -1;
+        std::vector<cgp::vec3> vertices;
+        std::vector<uint16_t> indices;
+        std::unordered_map<unsigned int, uint16_t> local_index; // global vertex index -> local index
+    };
+
+    std::vector<cell> cells;
+    std::unordered_map<int, int> first_cell; // partition index -> first cell
+    std::vector<pending_cell> pending;
+    std::unordered_map<int, int> last_pending; // partition index -> pending cell currently filled
+    unsigned int vertex_offset = 0;
+    int triangle_count = 0;
+
+    bool ray_cast_cell(int cell_index, cgp::vec3 const& start, cgp::vec3 const& director, float &min_dist, cgp::vec3 &result);
+
+public:
+    collision_compressed_mesh(collision_partition *_partition);
+
+    // Add a batch of world space triangles, indexing into positions. Can be called several times before compress()
+    void add_triangles(cgp::numarray<cgp::vec3> const& positions, cgp::numarray<cgp::uint3> const& triangles);
+    void add_triangles(collision_mesh const& shared);
+    // Quantise the pending triangles, must be called before the mesh is added to the partition
+    void compress();
+    // Remove every triangle so that the object can be filled again (remove it from the partition first)
+    void clear();
+
+    int get_triangle_count(){return triangle_count;}
+    size_t memory_footprint();
+
+    numarray<partition_coordinates> get_boxes(collision_partition* _partition) override;
+    using collision_cell_mesh::does_collide;
+    bool does_collide(collision_ray* ray, numarray<partition_coordinates> const& coords, vec3 &collision_point) override;
+};
+
+#endif // COLLISION_COMPRESSED_MESH_HPP
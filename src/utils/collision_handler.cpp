@@ -13,7 +13,7 @@ collision_handler::~collision_handler(){
 
 
 void collision_handler::initialize(collision_partition *_partition){
-    if(partition==NULL){return;}
+    if(_partition==NULL){return;}
     initialized=true;
     partition=_partition;
 }
@@ -51,7 +51,15 @@ bool collision_handler::does_collide(collision_object* col2, vec3 &collision_poi
         vec3 result;
         vec3 temp;
         for(collision_object* col: near_objects){
-            if(ray->does_collide(col, temp)){
+            bool collision;
+            if (dynamic_cast<collision_cell_mesh*>(col) != nullptr){
+                // The cells crossed by the ray are already known, no need to compute them again
+                collision = dynamic_cast<collision_cell_mesh*>(col)->does_collide(ray, coords, temp);
+            }
+            else{
+                collision = ray->does_collide(col, temp);
+            }
+            if(collision){
                 float dist = norm(ray->translation-temp);
                 if(min_dist==-1 || min_dist>dist){
                     min_dist=dist;
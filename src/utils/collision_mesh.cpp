@@ -0,0 +1,98 @@
+#include "collision_mesh.hpp"
+
+#include "math.hpp"
+
+
+using namespace cgp;
+
+
+collision_mesh::collision_mesh(collision_partition *_partition, mesh const* _source): collision_cell_mesh(_partition){
+    source = _source;
+    color = {0,0.7,1};
+}
+
+void collision_mesh::build(){
+    cells.clear();
+    triangles.clear();
+    cell_of_partition.clear();
+
+    // First pass: which cells each triangle touches
+    std::unordered_map<int, std::vector<uint32_t>> binned;
+    std::vector<int> cell_order; // keeps the build deterministic
+    std::unordered_map<int, partition_coordinates> coordinates;
+    for(int i=0;i<source->connectivity.size();i++){
+        uint3 const& triangle = source->connectivity[i];
+        vec3 p0 = get_world_position(triangle[0]);
+        vec3 p1 = get_world_position(triangle[1]);
+        vec3 p2 = get_world_position(triangle[2]);
+        numarray<partition_coordinates> Cs = get_triangle_boxes(p0,p1-p0,p2-p0,partition);
+        for(auto C : Cs){
+            int idx = partition->get_index(C);
+            auto found = binned.find(idx);
+            if(found==binned.end()){
+                cell_order.push_back(idx);
+                coordinates[idx] = (idx>=0) ? C : partition->get_out_coordinates();
+                binned[idx].push_back(i);
+            }
+            else{
+                found->second.push_back(i);
+            }
+        }
+    }
+
+    // Second pass: flatten the lists so that the triangles of a cell are contiguous in memory
+    cells.reserve(cell_order.size());
+    for(int idx : cell_order){
+        std::vector<uint32_t> const& list = binned[idx];
+        cell c;
+        c.coordinates = coordinates[idx];
+        c.start = triangles.size();
+        triangles.insert(triangles.end(),list.begin(),list.end());
+        c.end = triangles.size();
+        cell_of_partition[idx] = cells.size();
+        cells.push_back(c);
+    }
+    triangles.shrink_to_fit();
+}
+
+size_t collision_mesh::memory_footprint(){
+    return sizeof(collision_mesh) + cells.capacity()*sizeof(cell) + triangles.capacity()*sizeof(uint32_t) + cell_of_partition.size()*(sizeof(int)*2+sizeof(void*));
+}
+
+numarray<partition_coordinates> collision_mesh::get_boxes(collision_partition* _partition){
+    numarray<partition_coordinates> Cs;
+    if(_partition!=partition){return Cs;}
+    for(auto const& c : cells){
+        Cs.push_back(c.coordinates);
+    }
+    return Cs;
+}
+
+bool collision_mesh::does_collide(collision_ray* ray, numarray<partition_coordinates> const& coords, vec3 &collision_point){
+    float min_dist = -1;
+    vec3 result;
+    for(auto const& C : coords){
+        auto found = cell_of_partition.find(partition->get_index(C));
+        if(found==cell_of_partition.end()){continue;}
+        cell const& c = cells[found->second];
+        for(int i=c.start;i<c.end;i++){
+            uint3 const& triangle = source->connectivity[triangles[i]];
+            vec3 p0 = get_world_position(triangle[0]);
+            vec3 p1 = get_world_position(triangle[1]);
+            vec3 p2 = get_world_position(triangle[2]);
+            vec3 temp;
+            if(math::segment_triangle_intersection(ray->translation,ray->director,p0,p1-p0,p2-p0,temp)){
+                float dist = norm(ray->translation-temp);
+                if(min_dist<0 || min_dist>dist){
+                    min_dist = dist;
+                    result = temp;
+                }
+            }
+        }
+    }
+    if(min_dist>=0){
+        collision_point = result;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,47 @@
+#ifndef COLLISION_MESH_HPP
+#define COLLISION_MESH_HPP
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "collision_object.hpp"
+#include "touchable_object.hpp"
+
+// Collision geometry referencing the vertex buffer and the connectivity of a cgp::mesh.
+// No vertex is duplicated: the triangles are only stored as indices in the mesh connectivity, sorted by partition cell,
+// and the positions are taken from the mesh (then moved by the model transform) when a ray is tested.
+// The referenced mesh must outlive this object, and build() must be called again when its positions change.
+class collision_mesh: public collision_cell_mesh
+{
+private:
+    struct cell{
+        partition_coordinates coordinates;
+        int start;
+        int end;
+    };
+
+    cgp::mesh const* source = NULL;
+    std::vector<cell> cells;
+    std::vector<uint32_t> triangles; // connectivity indices, grouped by cell
+    std::unordered_map<int, int> cell_of_partition; // partition index -> cell
+
+public:
+    // Model transform applied to the mesh positions: translation + scaling*scaling_xyz*(rotation*p)
+    cgp::vec3 scaling_xyz = {1,1,1};
+
+    collision_mesh(collision_partition *_partition, cgp::mesh const* _source);
+
+    void build();
+    cgp::vec3 get_world_position(int idx) const {return translation + scaling*scaling_xyz*(rotation*source->position[idx]);}
+    cgp::mesh const* get_source() const {return source;}
+    int get_triangle_count(){return source->connectivity.size();}
+    size_t memory_footprint();
+
+    numarray<partition_coordinates> get_boxes(collision_partition* _partition) override;
+    using collision_cell_mesh::does_collide;
+    bool does_collide(collision_ray* ray, numarray<partition_coordinates> const& coords, vec3 &collision_point) override;
+};
+
+#endif // COLLISION_MESH_HPP
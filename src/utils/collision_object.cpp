@@ -62,7 +62,7 @@ std::ostream& operator<<(std::ostream &out, partition_coordinates C){
 collision_object::collision_object(){}
 bool collision_object::does_collide(collision_object* col2, vec3 &collision_point){if(col2!=NULL && collision_point.x==0){return false;}return false;}
 bool collision_object::does_collide(collision_object* col2){if(col2!=NULL){return false;}return false;}
-void collision_object::draw(environment_structure environment){cgp::draw(mesh_drawable(),environment);}
+void collision_object::draw(environment_structure const& environment){cgp::draw(mesh_drawable(),environment);}
 
 
 
@@ -101,7 +101,7 @@ bool collision_sphere::does_collide(collision_object* col2){
     vec3 vector;
     return does_collide(col2, vector);
 }
-void collision_sphere::draw(environment_structure environment){
+void collision_sphere::draw(environment_structure const& environment){
     if(draw_full){
         sphere.model.scaling = r*scaling;
         sphere.model.translation = translation;
@@ -264,7 +264,7 @@ bool collision_box::does_collide(collision_object* col2){
     vec3 vector;
     return does_collide(col2, vector);
 }
-void collision_box::draw(environment_structure environment){
+void collision_box::draw(environment_structure const& environment){
     if(draw_full){
         cube.model.translation = translation;
         cube.model.scaling_xyz = scaling_xyz*scaling;
@@ -443,13 +443,17 @@ bool collision_ray::does_collide(collision_object* col2, vec3 &collision_point){
         }
         return false;
     }
+    else if (dynamic_cast<collision_cell_mesh*>(col2) != nullptr){
+        collision_cell_mesh* cell_mesh = dynamic_cast<collision_cell_mesh*>(col2);
+        return cell_mesh->does_collide(this,collision_point);
+    }
     return false;
 }
 bool collision_ray::does_collide(collision_object* col2){
     vec3 temp;
     return does_collide(col2, temp);
 }
-void collision_ray::draw(environment_structure environment){
+void collision_ray::draw(environment_structure const& environment){
     numarray<vec3> positions;
     positions.resize(2);
     positions[0] = translation;
@@ -477,12 +481,13 @@ collision_triangle::collision_triangle(cgp::vec3 _start, cgp::vec3 _axis1, cgp::
     }
 }
 numarray<partition_coordinates> collision_triangle::get_boxes(collision_partition* partition){
+    return get_triangle_boxes(translation, scaling * axis1, scaling * axis2, partition);
+}
+numarray<partition_coordinates> get_triangle_boxes(vec3 start, vec3 axis1, vec3 axis2, collision_partition *partition){
     numarray<partition_coordinates> numarrarr[3];
-    vec3 axis1b = scaling * axis1;
-    vec3 axis2b = scaling * axis2;
-    numarrarr[0] = get_segment_boxes(math::segment(translation,axis1b), partition);
-    numarrarr[1] = get_segment_boxes(math::segment(translation,axis2b), partition);
-    numarrarr[2] = get_segment_boxes(math::segment(translation+axis1b,axis2b-axis1b), partition);
+    numarrarr[0] = get_segment_boxes(math::segment(start,axis1), partition);
+    numarrarr[1] = get_segment_boxes(math::segment(start,axis2), partition);
+    numarrarr[2] = get_segment_boxes(math::segment(start+axis1,axis2-axis1), partition);
     
 
     numarray<partition_coordinates> FinalVec;
@@ -520,7 +525,7 @@ bool collision_triangle::does_collide(collision_object* col2){
     vec3 temp;
     return does_collide(col2, temp);
 }
-void collision_triangle::draw(environment_structure environment){
+void collision_triangle::draw(environment_structure const& environment){
     numarray<vec3> pos;
     pos.resize(3);
     pos[0]={0,0,0};pos[1]=axis1;pos[2]=axis2;
@@ -531,3 +536,16 @@ void collision_triangle::draw(environment_structure environment){
     cgp::draw(triangle_mesh,environment);
 }
 
+
+
+bool collision_cell_mesh::does_collide(collision_object* col2, vec3 &collision_point){
+    if (dynamic_cast<collision_ray*>(col2) != nullptr){
+        collision_ray* ray = dynamic_cast<collision_ray*>(col2);
+        return does_collide(ray, ray->get_boxes(partition), collision_point);
+    }
+    return false;
+}
+bool collision_cell_mesh::does_collide(collision_object* col2){
+    vec3 temp;
+    return does_collide(col2, temp);
+}
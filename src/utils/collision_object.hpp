@@ -21,6 +21,11 @@ public:
 std::ostream& operator<<(std::ostream &out, partition_coordinates C);
 
 class collision_partition;
+namespace math{ struct segment; }
+
+// Partition cells crossed by a segment / covered by the edges of a triangle
+numarray<partition_coordinates> get_segment_boxes(math::segment segment, collision_partition *partition);
+numarray<partition_coordinates> get_triangle_boxes(cgp::vec3 start, cgp::vec3 axis1, cgp::vec3 axis2, collision_partition *partition);
 
 class collision_object
 {
@@ -41,7 +46,7 @@ public:
     virtual bool does_collide(collision_object* col2, vec3 &collision_point);
     virtual bool does_collide(collision_object* col2);
 
-    virtual void draw(environment_structure environment);
+    virtual void draw(environment_structure const& environment);
 };
 
 
@@ -65,7 +70,7 @@ public:
     bool is_in_box(cgp::vec3 start, cgp::vec3 end);
     bool does_collide(collision_object* col2, vec3 &collision_point);
     bool does_collide(collision_object* col2);
-    void draw(environment_structure environment);
+    void draw(environment_structure const& environment);
 };
 
 class collision_box: public collision_object
@@ -93,7 +98,7 @@ public:
     numarray<partition_coordinates> get_boxes(collision_partition* partition);
     bool does_collide(collision_object* col2, vec3 &collision_point);
     bool does_collide(collision_object* col2);
-    void draw(environment_structure environment);
+    void draw(environment_structure const& environment);
 };
 
 class collision_ray: public collision_object{
@@ -109,7 +114,7 @@ public:
     numarray<partition_coordinates> get_boxes(collision_partition* partition);
     bool does_collide(collision_object* col2, vec3 &collision_point);
     bool does_collide(collision_object* col2);
-    void draw(environment_structure environment);
+    void draw(environment_structure const& environment);
 };
 
 class collision_triangle: public collision_object{
@@ -125,7 +130,21 @@ public:
     numarray<partition_coordinates> get_boxes(collision_partition* partition);
     bool does_collide(collision_object* col2, vec3 &collision_point);
     bool does_collide(collision_object* col2);
-    void draw(environment_structure environment);
+    void draw(environment_structure const& environment);
+};
+
+// Static mesh whose triangles are sorted by partition cell: a ray only tests the triangles of the cells it crosses
+class collision_cell_mesh: public collision_object{
+protected:
+    collision_partition *partition;
+
+public:
+    collision_cell_mesh(collision_partition *_partition){partition = _partition;}
+
+    // Ray test restricted to the cells already computed by the caller
+    virtual bool does_collide(collision_ray* ray, numarray<partition_coordinates> const& coords, vec3 &collision_point) = 0;
+    bool does_collide(collision_object* col2, vec3 &collision_point);
+    bool does_collide(collision_object* col2);
 };
 
 #endif // COLLISION_OBJECT_HPP
@@ -0,0 +1,400 @@
+#include "fractal_noise.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define FRACTAL_NOISE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(FRACTAL_NOISE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FRACTAL_NOISE_AVX2
+#define FRACTAL_NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(FRACTAL_NOISE_X86) && defined(__AVX2__)
+#define FRACTAL_NOISE_AVX2
+#define FRACTAL_NOISE_TARGET_AVX2
+#endif
+
+using namespace cgp;
+
+namespace fractal_noise
+{
+    // The simplex noise below follows the one used by cgp::noise_perlin (S. Gustavson's simplexnoise1234),
+    // with the same operation order so that every implementation gives the same values.
+    static float const F2 = 0.366025403f; // (sqrt(3)-1)/2
+    static float const G2 = 0.211324865f; // (3-sqrt(3))/6
+
+    // Ken Perlin's permutation, repeated twice to avoid wrapping the indices
+    static int const perm[512] = {151,160,137,91,90,15,
+        131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+        190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+        88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+        77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+        102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+        135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+        5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+        223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+        129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+        251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+        49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+        138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180,
+        151,160,137,91,90,15,
+        131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,21,10,23,
+        190, 6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,
+        88,237,149,56,87,174,20,125,136,171,168, 68,175,74,165,71,134,139,48,27,166,
+        77,146,158,231,83,111,229,122,60,211,133,230,220,105,92,41,55,46,245,40,244,
+        102,143,54, 65,25,63,161, 1,216,80,73,209,76,132,187,208, 89,18,169,200,196,
+        135,130,116,188,159,86,164,100,109,198,173,186, 3,64,52,217,226,250,124,123,
+        5,202,38,147,118,126,255,82,85,212,207,206,59,227,47,16,58,17,182,189,28,42,
+        223,183,170,213,119,248,152, 2,44,154,163, 70,221,153,101,155,167, 43,172,9,
+        129,22,39,253, 19,98,108,110,79,113,224,232,178,185, 112,104,218,246,97,228,
+        251,34,242,193,238,210,144,12,191,179,162,241, 81,51,145,235,249,14,239,107,
+        49,192,214, 31,181,199,106,157,184, 84,204,176,115,121,50,45,127, 4,150,254,
+        138,236,205,93,222,114,67,29,24,72,243,141,128,195,78,66,215,61,156,180};
+
+    static int fast_floor(float x)
+    {
+        int const i = static_cast<int>(x);
+        return (i<=x) ? i : i-1;
+    }
+
+    static float grad2(int hash, float x, float y)
+    {
+        int const h = hash & 7;
+        float const u = h<4 ? x : y;
+        float const v = h<4 ? y : x;
+        return ((h&1) ? -u : u) + ((h&2) ? -2.0f*v : 2.0f*v);
+    }
+
+    static float simplex(float x, float y)
+    {
+        float const s = (x+y)*F2;
+        int const i = fast_floor(x+s);
+        int const j = fast_floor(y+s);
+
+        float const t = static_cast<float>(i+j)*G2;
+        float const x0 = x-(i-t);
+        float const y0 = y-(j-t);
+
+        int const i1 = (x0>y0) ? 1 : 0;
+        int const j1 = (x0>y0) ? 0 : 1;
+
+        float const x1 = x0 - i1 + G2;
+        float const y1 = y0 - j1 + G2;
+        float const x2 = x0 - 1.0f + 2.0f*G2;
+        float const y2 = y0 - 1.0f + 2.0f*G2;
+
+        int const ii = i & 0xff;
+        int const jj = j & 0xff;
+
+        float n0 = 0, n1 = 0, n2 = 0;
+        float t0 = 0.5f - x0*x0 - y0*y0;
+        if(t0>=0.0f){
+            t0 *= t0;
+            n0 = t0*t0*grad2(perm[ii+perm[jj]], x0, y0);
+        }
+        float t1 = 0.5f - x1*x1 - y1*y1;
+        if(t1>=0.0f){
+            t1 *= t1;
+            n1 = t1*t1*grad2(perm[ii+i1+perm[jj+j1]], x1, y1);
+        }
+        float t2 = 0.5f - x2*x2 - y2*y2;
+        if(t2>=0.0f){
+            t2 *= t2;
+            n2 = t2*t2*grad2(perm[ii+1+perm[jj+1]], x2, y2);
+        }
+        return 40.0f*(n0+n1+n2);
+    }
+
+    float perlin(vec2 const& p, int octave, float persistency, float frequency_gain)
+    {
+        float value = 0.0f;
+        float a = 1.0f; // current magnitude
+        float f = 1.0f; // current frequency
+        for(int k=0;k<octave;k++){
+            float const n = simplex(p.x*f, p.y*f);
+            value += a*(0.5f+0.5f*n);
+            f *= frequency_gain;
+            a *= persistency;
+        }
+        return value;
+    }
+
+    // Batch implementations: each one processes the points [0,N[ of x,y by packets and returns the number of points done
+    typedef int (*batch_function)(float const* x, float const* y, float* values, int N, int octave, float persistency, float frequency_gain);
+
+    static int perlin_scalar(float const* x, float const* y, float* values, int N, int octave, float persistency, float frequency_gain)
+    {
+        for(int k=0;k<N;k++){
+            values[k] = perlin({x[k],y[k]}, octave, persistency, frequency_gain);
+        }
+        return N;
+    }
+
+#ifdef FRACTAL_NOISE_X86
+    static __m128 grad2_sse(__m128i hash, __m128 x, __m128 y)
+    {
+        __m128i const h = _mm_and_si128(hash, _mm_set1_epi32(7));
+        __m128 const swap = _mm_castsi128_ps(_mm_cmpgt_epi32(h, _mm_set1_epi32(3)));
+        __m128 const u = _mm_or_ps(_mm_and_ps(swap,y), _mm_andnot_ps(swap,x));
+        __m128 const v = _mm_or_ps(_mm_and_ps(swap,x), _mm_andnot_ps(swap,y));
+        // Bits 1 and 2 of h are moved to the sign bit
+        __m128 const sign_u = _mm_castsi128_ps(_mm_slli_epi32(h,31));
+        __m128 const sign_v = _mm_castsi128_ps(_mm_slli_epi32(_mm_srli_epi32(h,1),31));
+        __m128 const v2 = _mm_add_ps(v,v);
+        return _mm_add_ps(_mm_xor_ps(u,sign_u), _mm_xor_ps(v2,sign_v));
+    }
+
+    static __m128i fast_floor_sse(__m128 x)
+    {
+        __m128i const i = _mm_cvttps_epi32(x);
+        __m128 const above = _mm_cmpgt_ps(_mm_cvtepi32_ps(i), x);
+        return _mm_add_epi32(i, _mm_castps_si128(above)); // above is -1 where the truncation rounded up
+    }
+
+    static __m128i lookup_sse(__m128i index)
+    {
+        alignas(16) int idx[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(idx), index);
+        return _mm_setr_epi32(perm[idx[0]], perm[idx[1]], perm[idx[2]], perm[idx[3]]);
+    }
+
+    static __m128 corner_sse(__m128 x, __m128 y, __m128i hash)
+    {
+        __m128 t = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(0.5f), _mm_mul_ps(x,x)), _mm_mul_ps(y,y));
+        __m128 const inside = _mm_cmpge_ps(t, _mm_setzero_ps());
+        t = _mm_mul_ps(t,t);
+        return _mm_and_ps(inside, _mm_mul_ps(_mm_mul_ps(t,t), grad2_sse(hash,x,y)));
+    }
+
+    static __m128 simplex_sse(__m128 x, __m128 y)
+    {
+        __m128 const s = _mm_mul_ps(_mm_add_ps(x,y), _mm_set1_ps(F2));
+        __m128i const i = fast_floor_sse(_mm_add_ps(x,s));
+        __m128i const j = fast_floor_sse(_mm_add_ps(y,s));
+
+        __m128 const t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(i,j)), _mm_set1_ps(G2));
+        __m128 const x0 = _mm_sub_ps(x, _mm_sub_ps(_mm_cvtepi32_ps(i),t));
+        __m128 const y0 = _mm_sub_ps(y, _mm_sub_ps(_mm_cvtepi32_ps(j),t));
+
+        __m128 const lower = _mm_cmpgt_ps(x0,y0);
+        __m128 const one = _mm_set1_ps(1.0f);
+        __m128 const i1 = _mm_and_ps(lower,one);
+        __m128 const j1 = _mm_andnot_ps(lower,one);
+
+        __m128 const x1 = _mm_add_ps(_mm_sub_ps(x0,i1), _mm_set1_ps(G2));
+        __m128 const y1 = _mm_add_ps(_mm_sub_ps(y0,j1), _mm_set1_ps(G2));
+        __m128 const x2 = _mm_add_ps(_mm_sub_ps(x0,one), _mm_set1_ps(2.0f*G2));
+        __m128 const y2 = _mm_add_ps(_mm_sub_ps(y0,one), _mm_set1_ps(2.0f*G2));
+
+        __m128i const mask = _mm_set1_epi32(0xff);
+        __m128i const ii = _mm_and_si128(i,mask);
+        __m128i const jj = _mm_and_si128(j,mask);
+        __m128i const i1i = _mm_cvtps_epi32(i1);
+        __m128i const j1i = _mm_cvtps_epi32(j1);
+        __m128i const one_i = _mm_set1_epi32(1);
+
+        __m128i const g0 = lookup_sse(_mm_add_epi32(ii, lookup_sse(jj)));
+        __m128i const g1 = lookup_sse(_mm_add_epi32(_mm_add_epi32(ii,i1i), lookup_sse(_mm_add_epi32(jj,j1i))));
+        __m128i const g2 = lookup_sse(_mm_add_epi32(_mm_add_epi32(ii,one_i), lookup_sse(_mm_add_epi32(jj,one_i))));
+
+        __m128 const n = _mm_add_ps(_mm_add_ps(corner_sse(x0,y0,g0), corner_sse(x1,y1,g1)), corner_sse(x2,y2,g2));
+        return _mm_mul_ps(_mm_set1_ps(40.0f), n);
+    }
+
+    static int perlin_sse(float const* x, float const* y, float* values, int N, int octave, float persistency, float frequency_gain)
+    {
+        int k = 0;
+        for(;k+4<=N;k+=4){
+            __m128 const px = _mm_loadu_ps(x+k);
+            __m128 const py = _mm_loadu_ps(y+k);
+            __m128 value = _mm_setzero_ps();
+            float a = 1.0f;
+            float f = 1.0f;
+            for(int o=0;o<octave;o++){
+                __m128 const n = simplex_sse(_mm_mul_ps(px,_mm_set1_ps(f)), _mm_mul_ps(py,_mm_set1_ps(f)));
+                __m128 const half = _mm_set1_ps(0.5f);
+                value = _mm_add_ps(value, _mm_mul_ps(_mm_set1_ps(a), _mm_add_ps(half,_mm_mul_ps(half,n))));
+                f *= frequency_gain;
+                a *= persistency;
+            }
+            _mm_storeu_ps(values+k, value);
+        }
+        return k;
+    }
+#endif
+
+#ifdef FRACTAL_NOISE_AVX2
+    FRACTAL_NOISE_TARGET_AVX2
+    static __m256 grad2_avx2(__m256i hash, __m256 x, __m256 y)
+    {
+        __m256i const h = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+        __m256 const swap = _mm256_castsi256_ps(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(3)));
+        __m256 const u = _mm256_blendv_ps(x,y,swap);
+        __m256 const v = _mm256_blendv_ps(y,x,swap);
+        __m256 const sign_u = _mm256_castsi256_ps(_mm256_slli_epi32(h,31));
+        __m256 const sign_v = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_srli_epi32(h,1),31));
+        __m256 const v2 = _mm256_add_ps(v,v);
+        return _mm256_add_ps(_mm256_xor_ps(u,sign_u), _mm256_xor_ps(v2,sign_v));
+    }
+
+    FRACTAL_NOISE_TARGET_AVX2
+    static __m256i fast_floor_avx2(__m256 x)
+    {
+        __m256i const i = _mm256_cvttps_epi32(x);
+        __m256 const above = _mm256_cmp_ps(_mm256_cvtepi32_ps(i), x, _CMP_GT_OQ);
+        return _mm256_add_epi32(i, _mm256_castps_si256(above));
+    }
+
+    FRACTAL_NOISE_TARGET_AVX2
+    static __m256 corner_avx2(__m256 x, __m256 y, __m256i hash)
+    {
+        __m256 t = _mm256_sub_ps(_mm256_sub_ps(_mm256_set1_ps(0.5f), _mm256_mul_ps(x,x)), _mm256_mul_ps(y,y));
+        __m256 const inside = _mm256_cmp_ps(t, _mm256_setzero_ps(), _CMP_GE_OQ);
+        t = _mm256_mul_ps(t,t);
+        return _mm256_and_ps(inside, _mm256_mul_ps(_mm256_mul_ps(t,t), grad2_avx2(hash,x,y)));
+    }
+
+    FRACTAL_NOISE_TARGET_AVX2
+    static __m256 simplex_avx2(__m256 x, __m256 y)
+    {
+        __m256 const s = _mm256_mul_ps(_mm256_add_ps(x,y), _mm256_set1_ps(F2));
+        __m256i const i = fast_floor_avx2(_mm256_add_ps(x,s));
+        __m256i const j = fast_floor_avx2(_mm256_add_ps(y,s));
+
+        __m256 const t = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_add_epi32(i,j)), _mm256_set1_ps(G2));
+        __m256 const x0 = _mm256_sub_ps(x, _mm256_sub_ps(_mm256_cvtepi32_ps(i),t));
+        __m256 const y0 = _mm256_sub_ps(y, _mm256_sub_ps(_mm256_cvtepi32_ps(j),t));
+
+        __m256 const lower = _mm256_cmp_ps(x0,y0,_CMP_GT_OQ);
+        __m256 const one = _mm256_set1_ps(1.0f);
+        __m256 const i1 = _mm256_and_ps(lower,one);
+        __m256 const j1 = _mm256_andnot_ps(lower,one);
+
+        __m256 const x1 = _mm256_add_ps(_mm256_sub_ps(x0,i1), _mm256_set1_ps(G2));
+        __m256 const y1 = _mm256_add_ps(_mm256_sub_ps(y0,j1), _mm256_set1_ps(G2));
+        __m256 const x2 = _mm256_add_ps(_mm256_sub_ps(x0,one), _mm256_set1_ps(2.0f*G2));
+        __m256 const y2 = _mm256_add_ps(_mm256_sub_ps(y0,one), _mm256_set1_ps(2.0f*G2));
+
+        __m256i const mask = _mm256_set1_epi32(0xff);
+        __m256i const ii = _mm256_and_si256(i,mask);
+        __m256i const jj = _mm256_and_si256(j,mask);
+        __m256i const i1i = _mm256_cvtps_epi32(i1);
+        __m256i const j1i = _mm256_cvtps_epi32(j1);
+        __m256i const one_i = _mm256_set1_epi32(1);
+
+        __m256i const g0 = _mm256_i32gather_epi32(perm, _mm256_add_epi32(ii, _mm256_i32gather_epi32(perm,jj,4)), 4);
+        __m256i const g1 = _mm256_i32gather_epi32(perm, _mm256_add_epi32(_mm256_add_epi32(ii,i1i), _mm256_i32gather_epi32(perm,_mm256_add_epi32(jj,j1i),4)), 4);
+        __m256i const g2 = _mm256_i32gather_epi32(perm, _mm256_add_epi32(_mm256_add_epi32(ii,one_i), _mm256_i32gather_epi32(perm,_mm256_add_epi32(jj,one_i),4)), 4);
+
+        __m256 const n = _mm256_add_ps(_mm256_add_ps(corner_avx2(x0,y0,g0), corner_avx2(x1,y1,g1)), corner_avx2(x2,y2,g2));
+        return _mm256_mul_ps(_mm256_set1_ps(40.0f), n);
+    }
+
+    FRACTAL_NOISE_TARGET_AVX2
+    static int perlin_avx2(float const* x, float const* y, float* values, int N, int octave, float persistency, float frequency_gain)
+    {
+        int k = 0;
+        for(;k+8<=N;k+=8){
+            __m256 const px = _mm256_loadu_ps(x+k);
+            __m256 const py = _mm256_loadu_ps(y+k);
+            __m256 value = _mm256_setzero_ps();
+            float a = 1.0f;
+            float f = 1.0f;
+            for(int o=0;o<octave;o++){
+                __m256 const n = simplex_avx2(_mm256_mul_ps(px,_mm256_set1_ps(f)), _mm256_mul_ps(py,_mm256_set1_ps(f)));
+                __m256 const half = _mm256_set1_ps(0.5f);
+                value = _mm256_add_ps(value, _mm256_mul_ps(_mm256_set1_ps(a), _mm256_add_ps(half,_mm256_mul_ps(half,n))));
+                f *= frequency_gain;
+                a *= persistency;
+            }
+            _mm256_storeu_ps(values+k, value);
+        }
+        return k;
+    }
+#endif
+
+    static bool has_avx2()
+    {
+#if defined(FRACTAL_NOISE_AVX2) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+#elif defined(FRACTAL_NOISE_AVX2)
+        return true; // compiled with /arch:AVX2
+#else
+        return false;
+#endif
+    }
+
+    static batch_function select_batch(char const* &name)
+    {
+#ifdef FRACTAL_NOISE_AVX2
+        if(has_avx2()){
+            name = "avx2";
+            return perlin_avx2;
+        }
+#endif
+#ifdef FRACTAL_NOISE_X86
+        name = "sse2";
+        return perlin_sse;
+#else
+        name = "scalar";
+        return perlin_scalar;
+#endif
+    }
+
+    static char const* batch_name = "scalar";
+    static batch_function const batch = select_batch(batch_name);
+
+    char const* instruction_set()
+    {
+        return batch_name;
+    }
+
+    void perlin(numarray<vec2> const& points, numarray<float> &values, int octave, float persistency, float frequency_gain)
+    {
+        int const N = points.size();
+        if(int(values.size())!=N){
+            values.resize(N);
+        }
+
+        // Structure of arrays copy of the coordinates, by packets to stay in the cache
+        int const packet = 256;
+        float x[packet];
+        float y[packet];
+        for(int start=0;start<N;start+=packet){
+            int const count = std::min(packet,N-start);
+            for(int k=0;k<count;k++){
+                x[k] = points[start+k].x;
+                y[k] = points[start+k].y;
+            }
+            float* result = &values[start];
+            int const done = batch(x,y,result,count,octave,persistency,frequency_gain);
+            perlin_scalar(x+done,y+done,result+done,count-done,octave,persistency,frequency_gain);
+        }
+    }
+
+    bool self_test()
+    {
+        // Points on a few rows, with a count that leaves a scalar tail after the batches
+        numarray<vec2> points(8*37);
+        for(int k=0;k<int(points.size());k++){
+            points[k] = {0.173f*(k%37) - 2.1f, 0.61f*(k/37) + 0.05f};
+        }
+        numarray<float> values;
+        int const octaves[2] = {1, 8};
+        for(int octave : octaves){
+            perlin(points, values, octave, 0.4f, 2.0f);
+            for(int k=0;k<int(points.size());k++){
+                float const reference = noise_perlin(points[k],octave,0.4f,2.0f);
+                if(std::abs(reference-values[k])>1e-4f*(1+std::abs(reference))){
+                    std::cerr << "Warning: fractal_noise::perlin (" << batch_name << ") differs from noise_perlin at (" << points[k].x << "," << points[k].y << "): " << values[k] << " instead of " << reference << std::endl;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+}
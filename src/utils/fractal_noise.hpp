@@ -0,0 +1,24 @@
+#ifndef FRACTAL_NOISE_HPP
+#define FRACTAL_NOISE_HPP
+
+#include "cgp/cgp.hpp"
+
+// Fractal 2D noise giving the same values as cgp::noise_perlin (sum of simplex noise octaves),
+// evaluated on batches of points with AVX2 (8 points at once) or SSE2 (4 points at once) when the processor supports it.
+namespace fractal_noise
+{
+    // Single point, scalar implementation
+    float perlin(cgp::vec2 const& p, int octave, float persistency, float frequency_gain);
+
+    // values[k] = perlin(points[k],...), values is resized if needed
+    void perlin(cgp::numarray<cgp::vec2> const& points, cgp::numarray<float> &values, int octave, float persistency, float frequency_gain);
+
+    // Instruction set used by the batch version: "avx2", "sse2" or "scalar"
+    char const* instruction_set();
+
+    // Compare the batch version with cgp::noise_perlin on a fixed set of points, print a warning and return false if they differ.
+    // Called once at startup, out of the generation code
+    bool self_test();
+}
+
+#endif // FRACTAL_NOISE_HPP
@@ -0,0 +1,68 @@
+#include "frustum.hpp"
+
+#include <cmath>
+
+using namespace cgp;
+
+
+void frustum::update(mat4 const& projection, mat4 const& view)
+{
+    // Planes read from the rows of projection*view (Gribb and Hartmann): left, right, bottom, top, near, far
+    mat4 const M = projection*view;
+    for(int k=0;k<3;k++){
+        for(int side=0;side<2;side++){
+            float const sign = side==0 ? 1.0f : -1.0f;
+            vec4 plane;
+            for(int c=0;c<4;c++){
+                plane[c] = M(3,c) + sign*M(k,c);
+            }
+            float const n = std::sqrt(plane.x*plane.x+plane.y*plane.y+plane.z*plane.z);
+            if(n>0){
+                plane = vec4(plane.x/n, plane.y/n, plane.z/n, plane.w/n);
+            }
+            planes[2*k+side] = plane;
+        }
+    }
+    valid = true;
+    tested_count = 0;
+    culled_count = 0;
+}
+
+bool frustum::count(bool visible) const
+{
+    tested_count++;
+    if(!visible){
+        culled_count++;
+    }
+    return visible;
+}
+
+bool frustum::is_box_visible(vec3 const& box_min, vec3 const& box_max) const
+{
+    if(!enabled || !valid){
+        return count(true);
+    }
+    for(vec4 const& plane : planes){
+        // Corner of the box the furthest along the plane normal
+        float const x = plane.x>=0 ? box_max.x : box_min.x;
+        float const y = plane.y>=0 ? box_max.y : box_min.y;
+        float const z = plane.z>=0 ? box_max.z : box_min.z;
+        if(plane.x*x+plane.y*y+plane.z*z+plane.w<0){
+            return count(false);
+        }
+    }
+    return count(true);
+}
+
+bool frustum::is_sphere_visible(vec3 const& center, float radius) const
+{
+    if(!enabled || !valid){
+        return count(true);
+    }
+    for(vec4 const& plane : planes){
+        if(plane.x*center.x+plane.y*center.y+plane.z*center.z+plane.w<-radius){
+            return count(false);
+        }
+    }
+    return count(true);
+}
@@ -0,0 +1,33 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "cgp/cgp.hpp"
+
+// View volume of the camera as 6 planes, to skip the draws of the objects entirely out of view.
+// The tests are conservative: an object reported invisible is certainly out of view, the reverse is not always true.
+// Each test is counted, so that the number of culled objects of the frame can be displayed.
+class frustum
+{
+    public:
+        bool enabled = true; // When disabled every object is visible (the tests are still counted)
+
+        // Planes from the camera matrices, to call once per frame before the draws. Resets the counters
+        void update(cgp::mat4 const& projection, cgp::mat4 const& view);
+
+        bool is_box_visible(cgp::vec3 const& box_min, cgp::vec3 const& box_max) const;
+        bool is_sphere_visible(cgp::vec3 const& center, float radius) const;
+
+        // Objects tested and found out of view since the last update
+        int tested() const {return tested_count;}
+        int culled() const {return culled_count;}
+
+    private:
+        cgp::vec4 planes[6]; // a*x+b*y+c*z+d >= 0 inside, (a,b,c) normalized
+        bool valid = false;
+        mutable int tested_count = 0;
+        mutable int culled_count = 0;
+
+        bool count(bool visible) const;
+};
+
+#endif // FRUSTUM_HPP
@@ -0,0 +1,44 @@
+#ifndef GPU_BUFFER_HPP
+#define GPU_BUFFER_HPP
+
+#include "cgp/cgp.hpp"
+
+// In place updates of the vertex buffers of a mesh_drawable: the buffers keep their id,
+// so that the geometry can be changed every frame without allocating new buffers.
+namespace gpu_buffer
+{
+    // Write the elements [first,first+count[ of data at the same place in the buffer.
+    // When the whole buffer is written it is orphaned first (the driver gives new storage instead of waiting for the previous draws),
+    // which also allows data to have a different size.
+    template <typename T>
+    void update(cgp::opengl_vbo_structure &vbo, cgp::numarray<T> const& data, int first = 0, int count = -1)
+    {
+        if(count<0){count = int(data.size())-first;}
+        if(vbo.id==0 || count<=0){return;}
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo.id);
+        if(first==0 && count==int(data.size())){
+            glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(data.size()*sizeof(T)), NULL, GL_DYNAMIC_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, GLsizeiptr(data.size()*sizeof(T)), &data[0]);
+            vbo.size = data.size();
+        }
+        else{
+            glBufferSubData(GL_ARRAY_BUFFER, GLintptr(first*sizeof(T)), GLsizeiptr(count*sizeof(T)), &data[first]);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Supplementary attribute number slot of drawable (in the order of creation): created on the first call, updated in place afterwards.
+    // divisor is the one of glVertexAttribDivisor (1 for a per instance attribute), used at the creation
+    template <typename T>
+    void attribute(cgp::mesh_drawable &drawable, int slot, cgp::numarray<T> const& data, GLuint location, int first = 0, int count = -1, GLuint divisor = 0)
+    {
+        if(slot>=int(drawable.supplementary_vbo.size())){
+            drawable.initialize_supplementary_data_on_gpu(data, location, divisor);
+            return;
+        }
+        update(drawable.supplementary_vbo[slot], data, first, count);
+    }
+}
+
+#endif // GPU_BUFFER_HPP
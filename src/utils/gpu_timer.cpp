@@ -0,0 +1,74 @@
+#include "gpu_timer.hpp"
+
+using namespace cgp;
+
+
+bool gpu_timer::supported()
+{
+#ifdef __EMSCRIPTEN__
+    return false;
+#else
+    return true;
+#endif
+}
+
+gpu_timer::~gpu_timer()
+{
+#ifndef __EMSCRIPTEN__
+    if(queries[0]!=0){
+        glDeleteQueries(query_count, queries);
+    }
+#endif
+}
+
+void gpu_timer::collect()
+{
+#ifndef __EMSCRIPTEN__
+    // Oldest query first, stopping at the first one not available yet
+    for(int k=0;k<query_count;k++){
+        int const index = (current+k)%query_count;
+        if(!pending[index]){
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available){
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &nanoseconds);
+        pending[index] = false;
+        last_milliseconds = nanoseconds*1e-6f;
+        average = (average==0) ? last_milliseconds : 0.95f*average + 0.05f*last_milliseconds;
+    }
+#endif
+}
+
+void gpu_timer::begin()
+{
+#ifndef __EMSCRIPTEN__
+    if(queries[0]==0){
+        glGenQueries(query_count, queries);
+    }
+    collect();
+    // Every query still in flight: this measure is skipped rather than waiting for the GPU
+    if(pending[current]){
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+    running = true;
+#endif
+}
+
+void gpu_timer::end()
+{
+#ifndef __EMSCRIPTEN__
+    if(!running){
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    running = false;
+    pending[current] = true;
+    current = (current+1)%query_count;
+#endif
+}
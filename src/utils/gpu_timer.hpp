@@ -0,0 +1,33 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+#include "cgp/cgp.hpp"
+
+// GPU time of the OpenGL commands issued between begin() and end(), measured with GL_TIME_ELAPSED queries.
+// The results arrive a few frames later: several queries are in flight so that reading them never stalls the CPU.
+// Not available in the web version (WebGL 2 has no timer queries without extension), milliseconds() then stays at 0.
+class gpu_timer
+{
+    public:
+        ~gpu_timer();
+
+        void begin();
+        void end();
+
+        float milliseconds() const {return last_milliseconds;} // Last result received
+        float average_milliseconds() const {return average;}   // Exponential moving average of the results
+        static bool supported();
+
+    private:
+        static int const query_count = 4;
+        GLuint queries[query_count] = {};
+        bool pending[query_count] = {};
+        int current = 0;
+        bool running = false;
+        float last_milliseconds = 0;
+        float average = 0;
+
+        void collect();
+};
+
+#endif // GPU_TIMER_HPP
@@ -0,0 +1,207 @@
+#include "light_clusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace cgp;
+
+
+int light_clusters::slice(float depth) const
+{
+    if(depth<=depth_near){
+        return 0;
+    }
+    int const s = int(std::floor(std::log(depth/depth_near)*depth_scale));
+    return std::min(std::max(s,0),size_z-1);
+}
+
+void light_clusters::build(std::vector<vec3> const& centers, std::vector<float> const& radii, std::vector<float> const& intensities, mat4 const& projection, mat4 const& view)
+{
+    // Near and far distances of a perspective projection, the far one being limited to keep useful slices
+    float const p22 = projection(2,2);
+    float const p23 = projection(2,3);
+    float near_distance = 0.1f;
+    float far_distance = 1000.0f;
+    if(projection(3,2)!=0 && p22!=1 && p22!=-1){
+        near_distance = std::max(p23/(p22-1), 1e-3f);
+        far_distance = p23/(p22+1);
+    }
+    far_distance = std::min(far_distance, near_distance*1e4f);
+    depth_near = near_distance;
+    depth_scale = (far_distance>near_distance) ? size_z/std::log(far_distance/near_distance) : 0;
+
+    // Cluster range of each light, from the projection of the corners of its bounding box in view space
+    int const N = centers.size();
+    int const cluster_count = size_x*size_y*size_z;
+    bounds.assign(6*N, 0);
+    view_centers.resize(N);
+    ranges.assign(2*cluster_count, 0);
+    for(int i=0;i<N;i++){
+        int *b = &bounds[6*i];
+        float const r = radii[i];
+        vec4 const c = view*vec4(centers[i],1.0f);
+        view_centers[i] = {c.x, c.y, c.z};
+        if(r<=0 || intensities[i]<=0){
+            b[0] = 1; b[1] = 0; // lights nothing
+            continue;
+        }
+
+        float w_min = 0, w_max = 0;
+        float x_min = 0, x_max = 0, y_min = 0, y_max = 0;
+        bool behind = false; // a corner is at or behind the camera: the sphere may cover the whole screen
+        for(int k=0;k<8;k++){
+            vec4 const corner = {c.x + ((k&1) ? r : -r), c.y + ((k&2) ? r : -r), c.z + ((k&4) ? r : -r), 1.0f};
+            vec4 const clip = projection*corner;
+            float const x = clip.w>1e-5f ? clip.x/clip.w : 0;
+            float const y = clip.w>1e-5f ? clip.y/clip.w : 0;
+            behind = behind || clip.w<=1e-5f;
+            w_min = (k==0) ? clip.w : std::min(w_min,clip.w);
+            w_max = (k==0) ? clip.w : std::max(w_max,clip.w);
+            x_min = (k==0) ? x : std::min(x_min,x);
+            x_max = (k==0) ? x : std::max(x_max,x);
+            y_min = (k==0) ? y : std::min(y_min,y);
+            y_max = (k==0) ? y : std::max(y_max,y);
+        }
+        if(w_max<=1e-5f || (!behind && (x_max<-1 || x_min>1 || y_max<-1 || y_min>1))){
+            b[0] = 1; b[1] = 0; // out of view
+            continue;
+        }
+        if(behind){
+            x_min = y_min = -1;
+            x_max = y_max = 1;
+        }
+        b[0] = std::max(0, std::min(size_x-1, int(std::floor((x_min*0.5f+0.5f)*size_x))));
+        b[1] = std::max(0, std::min(size_x-1, int(std::floor((x_max*0.5f+0.5f)*size_x))));
+        b[2] = std::max(0, std::min(size_y-1, int(std::floor((y_min*0.5f+0.5f)*size_y))));
+        b[3] = std::max(0, std::min(size_y-1, int(std::floor((y_max*0.5f+0.5f)*size_y))));
+        b[4] = slice(w_min);
+        b[5] = slice(w_max);
+
+        for(int z=b[4];z<=b[5];z++){
+            for(int y=b[2];y<=b[3];y++){
+                for(int x=b[0];x<=b[1];x++){
+                    ranges[2*((z*size_y+y)*size_x+x)+1]++;
+                }
+            }
+        }
+    }
+
+    // First index of each cluster, then the lists in light order
+    uint32_t total = 0;
+    max_count = 0;
+    for(int k=0;k<cluster_count;k++){
+        ranges[2*k] = total;
+        total += ranges[2*k+1];
+        max_count = std::max(max_count, int(ranges[2*k+1]));
+        ranges[2*k+1] = 0;
+    }
+    indices.assign(total, 0);
+    for(int i=0;i<N;i++){
+        int const *b = &bounds[6*i];
+        if(b[0]>b[1]){continue;}
+        for(int z=b[4];z<=b[5];z++){
+            for(int y=b[2];y<=b[3];y++){
+                for(int x=b[0];x<=b[1];x++){
+                    int const k = (z*size_y+y)*size_x+x;
+                    indices[ranges[2*k]+ranges[2*k+1]] = i;
+                    ranges[2*k+1]++;
+                }
+            }
+        }
+    }
+    limit_clusters(radii, intensities, projection);
+
+    // The index texture has at least one row, and its last row is padded
+    index_count = indices.size();
+    int const rows = std::max(1, int(index_count+index_width-1)/index_width);
+    indices.resize(rows*index_width, 0);
+}
+
+void light_clusters::limit_clusters(std::vector<float> const& radii, std::vector<float> const& intensities, mat4 const& projection)
+{
+    dropped = 0;
+    if(max_count<=max_per_cluster){
+        return;
+    }
+    bool const perspective = depth_scale>0;
+
+    // The lists are compacted in place: a cluster never moves after the end of its previous position
+    uint32_t total = 0;
+    int const cluster_count = size_x*size_y*size_z;
+    for(int k=0;k<cluster_count;k++){
+        uint32_t const first = ranges[2*k];
+        uint32_t count = ranges[2*k+1];
+        if(count>uint32_t(max_per_cluster)){
+            // Bounding sphere of the cluster in view space
+            vec3 center = {0,0,0};
+            float radius = 0;
+            if(perspective){
+                int const x = k%size_x;
+                int const y = (k/size_x)%size_y;
+                int const z = k/(size_x*size_y);
+                vec3 corners[8];
+                for(int c=0;c<8;c++){
+                    float const w = depth_near*std::exp((z + ((c&4) ? 1 : 0))/depth_scale);
+                    float const ndc_x = -1 + 2.0f*(x + ((c&1) ? 1 : 0))/size_x;
+                    float const ndc_y = -1 + 2.0f*(y + ((c&2) ? 1 : 0))/size_y;
+                    corners[c] = {w*(ndc_x+projection(0,2))/projection(0,0), w*(ndc_y+projection(1,2))/projection(1,1), -w};
+                    center += corners[c]/8.0f;
+                }
+                for(int c=0;c<8;c++){
+                    radius = std::max(radius, norm(corners[c]-center));
+                }
+            }
+
+            // Intensity left at the nearest point of the cluster (its bounding sphere), as the attenuation of the shaders
+            ranking.clear();
+            for(uint32_t j=0;j<count;j++){
+                uint32_t const i = indices[first+j];
+                float significance = intensities[i];
+                if(perspective){
+                    float const d = std::max(norm(view_centers[i]-center)-radius, 0.0f);
+                    significance *= std::max(1-d/radii[i], 0.0f);
+                }
+                ranking.push_back({-significance, i});
+            }
+            std::partial_sort(ranking.begin(), ranking.begin()+max_per_cluster, ranking.end());
+            for(int j=0;j<max_per_cluster;j++){
+                indices[total+j] = ranking[j].second;
+            }
+            dropped += count-max_per_cluster;
+            count = max_per_cluster;
+        }
+        else{
+            std::copy(indices.begin()+first, indices.begin()+first+count, indices.begin()+total);
+        }
+        ranges[2*k] = total;
+        ranges[2*k+1] = count;
+        total += count;
+    }
+    indices.resize(total);
+    max_count = max_per_cluster;
+}
+
+// Integer texture without filtering, read with texelFetch
+static void upload_texture(GLuint &texture, GLint internal_format, GLenum format, int width, int height, uint32_t const* data)
+{
+    if(texture==0){
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, GL_UNSIGNED_INT, data);
+}
+
+void light_clusters::upload(int unit_clusters, int unit_indices)
+{
+    int const rows = indices.size()/index_width; // padded by build()
+
+    glActiveTexture(GL_TEXTURE0 + unit_clusters);
+    upload_texture(texture_ranges, GL_RG32UI, GL_RG_INTEGER, size_x*size_y, size_z, ranges.data());
+    glActiveTexture(GL_TEXTURE0 + unit_indices);
+    upload_texture(texture_indices, GL_R32UI, GL_RED_INTEGER, index_width, rows, indices.data());
+    glActiveTexture(GL_TEXTURE0);
+}
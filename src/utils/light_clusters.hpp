@@ -0,0 +1,58 @@
+#ifndef LIGHT_CLUSTERS_HPP
+#define LIGHT_CLUSTERS_HPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+
+// Clustered forward lighting: the view volume is split into tiles on the screen and slices in depth (on a logarithmic scale),
+// and each cluster lists the lights whose sphere of influence reaches it. A fragment then only evaluates the lights of its cluster.
+// The lists are stored in two integer textures (OpenGL 3.3 and WebGL 2 have no storage buffers), read with texelFetch:
+//  - light_clusters, size_x*size_y by size_z: (first index, number of lights) of each cluster
+//  - light_indices, index_width wide: the light indices of every cluster, one after the other
+// A cluster keeps at most max_per_cluster lights, the most significant ones (intensity left at the nearest point of the cluster).
+class light_clusters
+{
+    public:
+        static int const size_x = 16;
+        static int const size_y = 9;
+        static int const size_z = 24;
+        static int const index_width = 1024;
+        static int const max_per_cluster = 32;
+
+        // Spheres (center, radius) of the lights in world space, and their intensity (the lights with no intensity are ignored)
+        void build(std::vector<cgp::vec3> const& centers, std::vector<float> const& radii, std::vector<float> const& intensities, cgp::mat4 const& projection, cgp::mat4 const& view);
+        // Upload the lists to the textures, and bind them to the texture units
+        void upload(int unit_clusters, int unit_indices);
+
+        // Depth slicing sent to the shaders: slice = log(depth/near)*depth_scale
+        float near() const {return depth_near;}
+        float scale() const {return depth_scale;}
+
+        int total_indices() const {return index_count;}
+        int max_lights_per_cluster() const {return max_count;}
+        int dropped_lights() const {return dropped;} // Light entries removed from the full clusters at the last build
+
+    private:
+        float depth_near = 0.1f;
+        float depth_scale = 0;
+        int max_count = 0;
+        int dropped = 0;
+        int index_count = 0; // indices used by the clusters, the rest of the last texture row is padding
+
+        std::vector<uint32_t> ranges; // first index and count of each cluster
+        std::vector<uint32_t> indices;
+        std::vector<int> bounds; // cluster range of each light: x0,x1,y0,y1,z0,z1 (empty if x0>x1)
+        std::vector<cgp::vec3> view_centers; // light centers in view space
+        std::vector<std::pair<float,uint32_t>> ranking;
+        GLuint texture_ranges = 0;
+        GLuint texture_indices = 0;
+
+        int slice(float depth) const;
+        // Keep the max_per_cluster most significant lights of the clusters having more
+        void limit_clusters(std::vector<float> const& radii, std::vector<float> const& intensities, cgp::mat4 const& projection);
+};
+
+#endif // LIGHT_CLUSTERS_HPP
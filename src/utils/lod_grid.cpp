@@ -0,0 +1,198 @@
+#include "lod_grid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "math.hpp"
+
+using namespace cgp;
+
+
+void lod_grid::initialize(mesh const& grid, int tiles_per_side){
+    N = std::sqrt(grid.position.size());
+    tiles.clear();
+    indices.clear();
+    full_triangles = grid.connectivity.size();
+    dirty = true;
+    if(N<2){
+        tile_count = 0;
+        return;
+    }
+
+    // Triangulation of one quad, read from the first quad of the full connectivity
+    int const fallback[2][3] = {{0,2,3},{0,3,1}};
+    bool valid = grid.connectivity.size()>=2;
+    for(int k=0;k<2 && valid;k++){
+        for(int c=0;c<3 && valid;c++){
+            int const idx = grid.connectivity[k][c];
+            int const du = idx/N;
+            int const dv = idx%N;
+            valid = (du<=1 && dv<=1);
+            pattern[k][c] = du*2+dv;
+        }
+    }
+    if(!valid){
+        std::copy(&fallback[0][0], &fallback[0][0]+6, &pattern[0][0]);
+    }
+
+    tile_count = std::min(tiles_per_side, N-1);
+    for(int tu=0;tu<tile_count;tu++){
+        for(int tv=0;tv<tile_count;tv++){
+            tile t;
+            t.u0 = tu*(N-1)/tile_count;
+            t.u1 = (tu+1)*(N-1)/tile_count;
+            t.v0 = tv*(N-1)/tile_count;
+            t.v1 = (tv+1)*(N-1)/tile_count;
+            tiles.push_back(t);
+        }
+    }
+    update_bounds(grid);
+}
+
+void lod_grid::update_bounds(mesh const& grid){
+    update_bounds(grid,0,N-1,0,N-1);
+}
+
+void lod_grid::update_bounds(mesh const& grid, int ku0, int ku1, int kv0, int kv1){
+    for(tile &t : tiles){
+        if(t.u1<ku0 || t.u0>ku1 || t.v1<kv0 || t.v0>kv1){continue;}
+        t.box_min = grid.position[t.u0*N+t.v0];
+        t.box_max = t.box_min;
+        for(int ku=t.u0;ku<=t.u1;ku++){
+            for(int kv=t.v0;kv<=t.v1;kv++){
+                vec3 const& p = grid.position[ku*N+kv];
+                for(int k=0;k<3;k++){
+                    t.box_min[k] = std::min(t.box_min[k],p[k]);
+                    t.box_max[k] = std::max(t.box_max[k],p[k]);
+                }
+            }
+        }
+    }
+}
+
+bool lod_grid::find_samples(vec3 const& box_min, vec3 const& box_max, int &ku0, int &ku1, int &kv0, int &kv1) const{
+    ku0 = N; ku1 = -1; kv0 = N; kv1 = -1;
+    for(tile const& t : tiles){
+        bool outside = false;
+        for(int k=0;k<3;k++){
+            outside = outside || t.box_max[k]<box_min[k] || t.box_min[k]>box_max[k];
+        }
+        if(outside){continue;}
+        ku0 = std::min(ku0,t.u0);
+        ku1 = std::max(ku1,t.u1);
+        kv0 = std::min(kv0,t.v0);
+        kv1 = std::max(kv1,t.v1);
+    }
+    return ku1>=0;
+}
+
+// Samples of [first,last] every step, last always included
+static std::vector<int> lod_samples(int first, int last, int step){
+    std::vector<int> samples;
+    for(int k=first;k<last;k+=step){
+        samples.push_back(k);
+    }
+    samples.push_back(last);
+    return samples;
+}
+
+// Previous sample of the coarse edge [first,last] sampled every step
+static int lod_snap(int k, int first, int last, int step){
+    if(k>=last){return last;}
+    return first + ((k-first)/step)*step;
+}
+
+void lod_grid::add_tile(tile const& t, int level_u0, int level_u1, int level_v0, int level_v1){
+    int const step = 1<<t.level;
+    // Step of each border: the coarsest of the two tiles sharing it
+    int const step_u0 = 1<<std::max(t.level,level_u0);
+    int const step_u1 = 1<<std::max(t.level,level_u1);
+    int const step_v0 = 1<<std::max(t.level,level_v0);
+    int const step_v1 = 1<<std::max(t.level,level_v1);
+
+    std::vector<int> const su = lod_samples(t.u0,t.u1,step);
+    std::vector<int> const sv = lod_samples(t.v0,t.v1,step);
+
+    auto index = [&](int ku, int kv){
+        if(ku==t.u0 && step_u0>step){kv = lod_snap(kv,t.v0,t.v1,step_u0);}
+        else if(ku==t.u1 && step_u1>step){kv = lod_snap(kv,t.v0,t.v1,step_u1);}
+        if(kv==t.v0 && step_v0>step){ku = lod_snap(ku,t.u0,t.u1,step_v0);}
+        else if(kv==t.v1 && step_v1>step){ku = lod_snap(ku,t.u0,t.u1,step_v1);}
+        return (unsigned int)(ku*N+kv);
+    };
+
+    for(int i=0;i+1<int(su.size());i++){
+        for(int j=0;j+1<int(sv.size());j++){
+            unsigned int const corners[4] = {index(su[i],sv[j]), index(su[i],sv[j+1]), index(su[i+1],sv[j]), index(su[i+1],sv[j+1])};
+            for(int k=0;k<2;k++){
+                uint3 const triangle = {corners[pattern[k][0]], corners[pattern[k][1]], corners[pattern[k][2]]};
+                // Triangles collapsed by the snapping are skipped
+                if(triangle[0]==triangle[1] || triangle[1]==triangle[2] || triangle[0]==triangle[2]){continue;}
+                indices.push_back(triangle);
+            }
+        }
+    }
+}
+
+void lod_grid::build_indices(){
+    indices.clear();
+    for(int tu=0;tu<tile_count;tu++){
+        for(int tv=0;tv<tile_count;tv++){
+            tile const& t = tiles[tu*tile_count+tv];
+            if(!t.visible){continue;}
+            // On the border of the grid, the tile is its own neighbour
+            int const level_u0 = (tu>0) ? tiles[(tu-1)*tile_count+tv].level : t.level;
+            int const level_u1 = (tu<tile_count-1) ? tiles[(tu+1)*tile_count+tv].level : t.level;
+            int const level_v0 = (tv>0) ? tiles[tu*tile_count+tv-1].level : t.level;
+            int const level_v1 = (tv<tile_count-1) ? tiles[tu*tile_count+tv+1].level : t.level;
+            add_tile(t,level_u0,level_u1,level_v0,level_v1);
+        }
+    }
+}
+
+void lod_grid::update(mesh_drawable &drawable, vec3 const& camera_position, frustum const* view){
+    if(tiles.empty() || drawable.ebo_connectivity.id==0){return;}
+
+    affine_rts const& model = drawable.model;
+    for(tile &t : tiles){
+        // World bounding box of the 8 transformed corners
+        vec3 world_min, world_max;
+        for(int c=0;c<8;c++){
+            vec3 const local = {(c&1) ? t.box_max.x : t.box_min.x, (c&2) ? t.box_max.y : t.box_min.y, (c&4) ? t.box_max.z : t.box_min.z};
+            vec3 const p = model.translation + model.scaling*(model.rotation*(model.scaling_xyz*local));
+            for(int k=0;k<3;k++){
+                world_min[k] = (c==0) ? p[k] : std::min(world_min[k],p[k]);
+                world_max[k] = (c==0) ? p[k] : std::max(world_max[k],p[k]);
+            }
+        }
+        float const distance = math::point_box_distance(camera_position,world_min,world_max);
+
+        int level = 0;
+        while(level<level_count-1 && distance>=lod_distance*(1<<level)){
+            level++;
+        }
+        if(level!=t.level){
+            t.level = level;
+            dirty = true;
+        }
+        bool const visible = (view==NULL) || view->is_box_visible(world_min,world_max);
+        if(visible!=t.visible){
+            t.visible = visible;
+            dirty = true;
+        }
+    }
+    if(!dirty){return;}
+
+    build_indices();
+    // All the levels use at most the triangles of the full resolution: the buffer allocated by initialize_data_on_gpu is reused
+    if(int(indices.size())>full_triangles){return;}
+    if(indices.size()>0){
+        glBindVertexArray(0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, drawable.ebo_connectivity.id);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, GLsizeiptr(indices.size()*sizeof(uint3)), &indices[0]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+    drawable.ebo_connectivity.size = indices.size(); // number of triangles drawn by cgp::draw
+    drawn_triangles = indices.size();
+    dirty = false;
+}
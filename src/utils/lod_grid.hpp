@@ -0,0 +1,61 @@
+#ifndef LOD_GRID_HPP
+#define LOD_GRID_HPP
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "frustum.hpp"
+
+// Distance based levels of detail for a square grid mesh (as built by mesh_primitive_grid).
+// The grid is split in tiles, each tile being drawn with one vertex every 2^level samples.
+// On the border between two tiles of different levels, the vertices of the finer tile that do not exist in the coarser one
+// are snapped on the previous coarse vertex, so both tiles share the same edge and no crack appears.
+// Only the index buffer of the mesh_drawable changes, the vertex buffers stay at full resolution.
+// The tiles out of the camera view are left out of the index buffer as well.
+class lod_grid
+{
+private:
+    struct tile{
+        int u0,u1,v0,v1; // sample range, borders included
+        cgp::vec3 box_min; // local bounding box
+        cgp::vec3 box_max;
+        int level = 0;
+        bool visible = true;
+    };
+
+    int N = 0;
+    int tile_count = 0;
+    std::vector<tile> tiles;
+    int pattern[2][3]; // corners (0:00, 1:01, 2:10, 3:11) of the two triangles of a quad, as in the full connectivity
+    int full_triangles = 0;
+    int drawn_triangles = 0;
+    bool dirty = true;
+
+    cgp::numarray<cgp::uint3> indices;
+
+    void build_indices();
+    void add_tile(tile const& t, int level_u0, int level_u1, int level_v0, int level_v1);
+
+public:
+    int level_count = 4;
+    float lod_distance = 7; // tiles closer than lod_distance are drawn at full resolution, the distance doubles at each level
+
+    // Tiles and corner pattern from the grid, the positions are only used for the bounding boxes
+    void initialize(cgp::mesh const& grid, int tiles_per_side = 8);
+    // Bounding boxes of the tiles after the positions changed
+    void update_bounds(cgp::mesh const& grid);
+    // Same, only for the tiles sharing a sample with [ku0,ku1] x [kv0,kv1]
+    void update_bounds(cgp::mesh const& grid, int ku0, int ku1, int kv0, int kv1);
+    // Samples [ku0,ku1] x [kv0,kv1] covering the tiles whose bounding box intersects the local box, false when there is none
+    bool find_samples(cgp::vec3 const& box_min, cgp::vec3 const& box_max, int &ku0, int &ku1, int &kv0, int &kv1) const;
+    // The GPU index buffer holds the full connectivity again (after initialize_data_on_gpu)
+    void reset(){dirty = true;}
+
+    // Choose the level and the visibility (when view is given) of each tile from the camera, and rewrite the index buffer of drawable if needed
+    void update(cgp::mesh_drawable &drawable, cgp::vec3 const& camera_position, frustum const* view = NULL);
+
+    int get_drawn_triangles(){return drawn_triangles;}
+    int get_full_triangles(){return full_triangles;}
+};
+
+#endif // LOD_GRID_HPP
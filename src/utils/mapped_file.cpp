@@ -0,0 +1,71 @@
+#include "mapped_file.hpp"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_MMAP
+#endif
+
+
+mapped_file::~mapped_file(){
+    close();
+}
+
+bool mapped_file::open(std::string const& path){
+    close();
+
+#ifdef MAPPED_FILE_MMAP
+    int const descriptor = ::open(path.c_str(), O_RDONLY);
+    if(descriptor>=0){
+        struct stat status;
+        if(fstat(descriptor,&status)==0 && status.st_size>0){
+            void* address = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if(address!=MAP_FAILED){
+                content = static_cast<char const*>(address);
+                length = status.st_size;
+                mapped = true;
+            }
+        }
+        // The mapping stays valid once the descriptor is closed
+        ::close(descriptor);
+        if(mapped){
+            return true;
+        }
+    }
+#endif
+
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if(!stream){
+        return false;
+    }
+    std::streamsize const file_size = stream.tellg();
+    if(file_size<=0){
+        return false;
+    }
+    buffer.resize(file_size);
+    stream.seekg(0);
+    if(!stream.read(buffer.data(), file_size)){
+        buffer.clear();
+        return false;
+    }
+    content = buffer.data();
+    length = buffer.size();
+    return true;
+}
+
+void mapped_file::close(){
+#ifdef MAPPED_FILE_MMAP
+    if(mapped){
+        munmap(const_cast<char*>(content), length);
+    }
+#endif
+    content = NULL;
+    length = 0;
+    mapped = false;
+    buffer.clear();
+    buffer.shrink_to_fit();
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read only view of a whole file. The file is memory mapped where possible (mmap on POSIX systems),
+// so that its pages are only read when they are accessed. Other platforms read it into memory.
+class mapped_file
+{
+private:
+    char const* content = NULL;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<char> buffer; // content when the file could not be mapped
+
+public:
+    mapped_file(){}
+    ~mapped_file();
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    bool open(std::string const& path); // false if the file does not exist or cannot be read
+    void close();
+
+    bool is_open() const {return content!=NULL;}
+    char const* data() const {return content;}
+    size_t size() const {return length;}
+};
+
+#endif // MAPPED_FILE_HPP
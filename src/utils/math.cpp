@@ -1,5 +1,7 @@
 #include "math.hpp"
 
+#include <algorithm>
+
 
 // using namespace math;
 math::plane::plane(vec3 point, vec3 normal)
@@ -143,6 +145,36 @@ bool math::parallelogram_segment_intersection(math::parallelogram parallelogram,
     return math::parallelogram_segment_intersection(parallelogram, segment, dummy);
 }
 
+bool math::segment_triangle_intersection(vec3 const& start, vec3 const& director, vec3 const& point0, vec3 const& axis1, vec3 const& axis2, vec3 &intersection)
+{
+    vec3 p = cgp::cross(director, axis2);
+    float det = cgp::dot(axis1, p);
+    if (cgp::abs(det) <= 1e-12)
+    {
+        return false;
+    } // Segment parallel to the triangle, not considered as a collision (same as plane_line_intersection)
+    float inv_det = 1.0f / det;
+    vec3 to = start - point0;
+    float l1 = cgp::dot(to, p) * inv_det;
+    if (l1 < 0 || l1 > 1)
+    {
+        return false;
+    }
+    vec3 q = cgp::cross(to, axis1);
+    float l2 = cgp::dot(director, q) * inv_det;
+    if (l2 < 0 || l1 + l2 > 1)
+    {
+        return false;
+    }
+    float t = cgp::dot(axis2, q) * inv_det;
+    if (t < 0 || t > 1)
+    {
+        return false;
+    }
+    intersection = start + t * director;
+    return true;
+}
+
 static cgp::curve_drawable math_draw_curve;
 static bool curve_initialized = false;
 void initialize_curve()
@@ -155,7 +187,7 @@ void initialize_curve()
         curve_initialized = true;
     }
 }
-void math::draw(segment segment, environment_structure environment)
+void math::draw(segment segment, environment_structure const& environment)
 {
     initialize_curve();
     numarray<vec3> positions;
@@ -166,7 +198,7 @@ void math::draw(segment segment, environment_structure environment)
     math_draw_curve.vbo_position.update(positions);
     cgp::draw(math_draw_curve, environment);
 }
-void math::draw(parallelogram parallelogram, environment_structure environment)
+void math::draw(parallelogram parallelogram, environment_structure const& environment)
 {
     initialize_curve();
     numarray<vec3> positions;
@@ -215,4 +247,25 @@ vec3 math::calculate_tangent(const vec3& position1, const vec3& position2, const
 vec3 math::calculate_bitangent(const vec3& tangent, const vec3& normal) {
     // Calculate bitangent as cross product of tangent and normal
     return normalize(cross(normal, tangent));
-}
\ No newline at end of file
+}
+
+vec3 math::camera_position(mat4 const& camera_view)
+{
+    // The view matrix is [R | t] (world to camera), the camera is at -R^T t
+    vec3 position;
+    for (int j = 0; j < 3; ++j)
+    {
+        position[j] = -(camera_view(0,j)*camera_view(0,3) + camera_view(1,j)*camera_view(1,3) + camera_view(2,j)*camera_view(2,3));
+    }
+    return position;
+}
+
+float math::point_box_distance(vec3 const& point, vec3 const& box_min, vec3 const& box_max)
+{
+    vec3 d;
+    for (int k = 0; k < 3; ++k)
+    {
+        d[k] = std::max(std::max(box_min[k]-point[k], 0.0f), point[k]-box_max[k]);
+    }
+    return norm(d);
+}
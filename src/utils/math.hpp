@@ -44,16 +44,23 @@ namespace math{
     bool plane_line_intersection(plane plane, line line);
     bool parallelogram_segment_intersection(parallelogram parallelogram, segment segment, vec3 &intersection);
     bool parallelogram_segment_intersection(parallelogram parallelogram, segment segment);
+    // Segment [start,start+director] against triangle (point0, point0+axis1, point0+axis2), Moller-Trumbore
+    bool segment_triangle_intersection(vec3 const& start, vec3 const& director, vec3 const& point0, vec3 const& axis1, vec3 const& axis2, vec3 &intersection);
 
     
-    void draw(segment segment,environment_structure environment);
-    void draw(parallelogram parallelogram,environment_structure environment);
+    void draw(segment segment,environment_structure const& environment);
+    void draw(parallelogram parallelogram,environment_structure const& environment);
 
 
     vec3 calculate_tangent(const vec3& position1, const vec3& position2, const vec3& position3,
                       const vec2& texCoord1, const vec2& texCoord2, const vec2& texCoord3,
                       const vec3& normal1);
     vec3 calculate_bitangent(const vec3& tangent, const vec3& normal);
+
+    // World position of the camera from its view matrix
+    vec3 camera_position(mat4 const& camera_view);
+    // Distance from a point to an axis aligned box (0 inside)
+    float point_box_distance(vec3 const& point, vec3 const& box_min, vec3 const& box_max);
 }
 
 #endif // MATH_HPP
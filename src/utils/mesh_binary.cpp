@@ -0,0 +1,108 @@
+#include "mesh_binary.hpp"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "binary_cache.hpp"
+#include "tangent_space.hpp"
+
+using namespace cgp;
+
+
+namespace mesh_binary
+{
+    // Identifies the content of the file, the layout version is checked by binary_cache
+    static uint64_t const format_key = binary_cache::hash("cgp::mesh", 9);
+
+    // Last modification time, 0 if the file does not exist
+    static long long modification_time(std::string const& path)
+    {
+        struct stat status;
+        if(stat(path.c_str(),&status)!=0){
+            return 0;
+        }
+        return status.st_mtime;
+    }
+
+    std::string binary_path(std::string const& obj_path)
+    {
+        size_t const dot = obj_path.find_last_of('.');
+        size_t const slash = obj_path.find_last_of("/\\");
+        if(dot==std::string::npos || (slash!=std::string::npos && dot<slash)){
+            return obj_path + ".cmesh";
+        }
+        return obj_path.substr(0,dot) + ".cmesh";
+    }
+
+    bool save(std::string const& path, mesh const& shape, numarray<vec3> const& tangents, numarray<vec3> const& bitangents)
+    {
+        binary_cache::writer file;
+        if(!file.open(path,format_key)){
+            return false;
+        }
+        file.write(shape.position);
+        file.write(shape.normal);
+        file.write(shape.uv);
+        file.write(shape.color);
+        file.write(shape.connectivity);
+        file.write(tangents);
+        file.write(bitangents);
+        return file.close();
+    }
+
+    bool load(std::string const& path, mesh &shape, numarray<vec3> &tangents, numarray<vec3> &bitangents)
+    {
+        binary_cache::reader file;
+        if(!file.open(path,format_key)){
+            return false;
+        }
+        bool const valid = file.read(shape.position) && file.read(shape.normal) && file.read(shape.uv) && file.read(shape.color)
+                        && file.read(shape.connectivity) && file.read(tangents) && file.read(bitangents);
+        size_t const N = shape.position.size();
+        if(!valid || shape.normal.size()!=N || shape.uv.size()!=N || shape.color.size()!=N || tangents.size()!=N || bitangents.size()!=N){
+            return false;
+        }
+        for(uint3 const& triangle : shape.connectivity){
+            if(triangle[0]>=N || triangle[1]>=N || triangle[2]>=N){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool convert(std::string const& obj_path)
+    {
+        mesh shape = mesh_load_file_obj(obj_path);
+        if(shape.position.size()==0){
+            std::cout << "mesh_binary: cannot read " << obj_path << std::endl;
+            return false;
+        }
+        shape.fill_empty_field();
+        numarray<vec3> tangents;
+        numarray<vec3> bitangents;
+        tangent_space::compute(shape,tangents,bitangents);
+
+        std::string const path = binary_path(obj_path);
+        if(!save(path,shape,tangents,bitangents)){
+            std::cout << "mesh_binary: cannot write " << path << std::endl;
+            return false;
+        }
+        std::cout << "mesh_binary: " << obj_path << " -> " << path << " (" << shape.position.size() << " vertices, " << shape.connectivity.size() << " triangles)" << std::endl;
+        return true;
+    }
+
+    void load_mesh(std::string const& obj_path, mesh &shape, numarray<vec3> &tangents, numarray<vec3> &bitangents)
+    {
+        std::string const path = binary_path(obj_path);
+        long long const binary_time = modification_time(path);
+        if(binary_time!=0 && binary_time>=modification_time(obj_path)){
+            if(load(path,shape,tangents,bitangents)){
+                return;
+            }
+            std::cout << "mesh_binary: invalid file " << path << ", loading the OBJ instead" << std::endl;
+        }
+        shape = mesh_load_file_obj(obj_path);
+        tangents.clear();
+        bitangents.clear();
+    }
+}
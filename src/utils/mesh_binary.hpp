@@ -0,0 +1,25 @@
+#ifndef MESH_BINARY_HPP
+#define MESH_BINARY_HPP
+
+#include <string>
+
+#include "cgp/cgp.hpp"
+
+// Binary version of the OBJ assets (.cmesh next to the .obj file), written offline by convert() (see scripts/convert_meshes.py).
+// The attributes are stored one after the other (position, normal, uv, color, connectivity, tangent, bitangent),
+// each one in the memory layout of its numarray, so that loading is a memory mapping followed by one copy per attribute.
+namespace mesh_binary
+{
+    std::string binary_path(std::string const& obj_path); // assets/a.obj -> assets/a.cmesh
+
+    bool save(std::string const& path, cgp::mesh const& shape, cgp::numarray<cgp::vec3> const& tangents, cgp::numarray<cgp::vec3> const& bitangents);
+    bool load(std::string const& path, cgp::mesh &shape, cgp::numarray<cgp::vec3> &tangents, cgp::numarray<cgp::vec3> &bitangents);
+
+    // Parse the OBJ file, compute its tangent frames and write its binary version
+    bool convert(std::string const& obj_path);
+
+    // The binary version of obj_path if it exists and is not older than the OBJ, the OBJ otherwise (tangents are then left empty)
+    void load_mesh(std::string const& obj_path, cgp::mesh &shape, cgp::numarray<cgp::vec3> &tangents, cgp::numarray<cgp::vec3> &bitangents);
+}
+
+#endif // MESH_BINARY_HPP
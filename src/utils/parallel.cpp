@@ -0,0 +1,123 @@
+#include "parallel.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace parallel
+{
+    // Worker threads waiting for jobs, started at the first parallel_for and stopped at the end of the program
+    class worker_pool
+    {
+        public:
+            worker_pool()
+            {
+                for(int t=1;t<thread_count();t++){
+                    workers.push_back(std::thread(&worker_pool::worker_loop, this));
+                }
+            }
+
+            ~worker_pool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                wake.notify_all();
+                for(std::thread &worker : workers){
+                    worker.join();
+                }
+            }
+
+            void push(std::function<void()> job)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    jobs.push_back(std::move(job));
+                }
+                wake.notify_one();
+            }
+
+            // Run one pending job on the calling thread, false if there is none
+            bool run_one()
+            {
+                std::function<void()> job;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(jobs.empty()){
+                        return false;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                }
+                job();
+                return true;
+            }
+
+        private:
+            std::vector<std::thread> workers;
+            std::deque<std::function<void()>> jobs;
+            std::mutex mutex;
+            std::condition_variable wake;
+            bool stopping = false;
+
+            void worker_loop()
+            {
+                while(true){
+                    std::function<void()> job;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        wake.wait(lock, [this](){return stopping || !jobs.empty();});
+                        if(jobs.empty()){
+                            return;
+                        }
+                        job = std::move(jobs.front());
+                        jobs.pop_front();
+                    }
+                    job();
+                }
+            }
+    };
+
+    static worker_pool& pool()
+    {
+        static worker_pool instance;
+        return instance;
+    }
+
+    void run_blocks(int block_count, std::function<void(int)> const& block)
+    {
+        worker_pool &workers = pool();
+
+        // Blocks left, decremented under the lock so that this function only returns once the last job released it
+        int remaining = block_count-1;
+        std::mutex done_mutex;
+        std::condition_variable done;
+        for(int b=1;b<block_count;b++){
+            workers.push([b,&block,&remaining,&done_mutex,&done](){
+                block(b);
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if(--remaining==0){
+                    done.notify_all();
+                }
+            });
+        }
+        block(0);
+
+        // Help with the pending jobs (these blocks or the ones of another caller), then wait for the blocks still running
+        while(true){
+            {
+                std::lock_guard<std::mutex> lock(done_mutex);
+                if(remaining==0){
+                    return;
+                }
+            }
+            if(!workers.run_one()){
+                std::unique_lock<std::mutex> lock(done_mutex);
+                done.wait(lock, [&remaining](){return remaining==0;});
+                return;
+            }
+        }
+    }
+}
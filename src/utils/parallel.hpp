@@ -0,0 +1,52 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+
+namespace parallel
+{
+    // Number of threads used by parallel_for (the calling thread and the workers of the pool)
+    inline int thread_count()
+    {
+#ifdef __EMSCRIPTEN__
+        return 1;
+#else
+        int const count = std::thread::hardware_concurrency();
+        return std::max(count,1);
+#endif
+    }
+
+    // Call block(b) for every b in [0,block_count[: block 0 on the calling thread, the others on the worker threads,
+    // started once for the whole program. Returns when every block is done.
+    // While waiting, the calling thread runs the pending blocks itself, so parallel_for can be called from a worker thread.
+    void run_blocks(int block_count, std::function<void(int)> const& block);
+
+    // Call task(k) for every k in [begin,end[.
+    // The range is cut into contiguous blocks, one per thread, so that each index is processed by exactly one thread:
+    // as long as task(k) only writes data owned by k, the result is identical to the serial loop.
+    // A block has at least min_block indices: a small range runs serially, on the calling thread.
+    template <typename F>
+    void parallel_for(int begin, int end, F const& task, int min_block = 1)
+    {
+        int const N = end-begin;
+        int const blocks = std::min(thread_count(), N/std::max(min_block,1));
+        if(blocks<=1){
+            for(int k=begin;k<end;k++){
+                task(k);
+            }
+            return;
+        }
+
+        run_blocks(blocks, [begin,N,blocks,&task](int b){
+            int const first = begin + (N*b)/blocks;
+            int const last = begin + (N*(b+1))/blocks;
+            for(int k=first;k<last;k++){
+                task(k);
+            }
+        });
+    }
+}
+
+#endif // PARALLEL_HPP
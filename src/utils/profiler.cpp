@@ -0,0 +1,239 @@
+#include "profiler.hpp"
+
+#include <fstream>
+
+#include "gpu_timer.hpp"
+
+using namespace cgp;
+
+
+profiler::~profiler()
+{
+    for(slot &s : slots){
+        if(!s.queries.empty()){
+            glDeleteQueries(GLsizei(s.queries.size()), s.queries.data());
+        }
+    }
+}
+
+int profiler::find(std::string const& name)
+{
+    for(int k=0;k<int(sections.size());k++){
+        if(sections[k].name==name){
+            return k;
+        }
+    }
+    section added;
+    added.name = name;
+    added.cpu_history.assign(history_size, -1.0f);
+    added.gpu_history.assign(history_size, -1.0f);
+    sections.push_back(added);
+    return int(sections.size())-1;
+}
+
+int profiler::timestamp()
+{
+    slot &s = slots[frame%slot_count];
+    if(s.used==int(s.queries.size())){
+        // New queries are created as needed, and reused in the following frames
+        GLuint query = 0;
+        glGenQueries(1, &query);
+        s.queries.push_back(query);
+    }
+#ifndef __EMSCRIPTEN__
+    glQueryCounter(s.queries[s.used], GL_TIMESTAMP);
+#endif
+    return s.used++;
+}
+
+void profiler::begin(std::string const& name)
+{
+    if(!enabled){
+        return;
+    }
+    int const k = find(name);
+    open_sections.push_back(k);
+    sections[k].start = std::chrono::steady_clock::now();
+    sections[k].opened = true;
+    begin_gpu(k);
+}
+
+void profiler::end()
+{
+    if(!enabled || open_sections.empty()){
+        return;
+    }
+    end_gpu();
+    section &s = sections[open_sections.back()];
+    s.cpu_milliseconds += std::chrono::duration<float,std::milli>(std::chrono::steady_clock::now()-s.start).count();
+    open_sections.pop_back();
+}
+
+int profiler::current() const
+{
+    return (!enabled || open_sections.empty()) ? -1 : open_sections.back();
+}
+
+void profiler::begin_gpu(int section)
+{
+    if(!enabled || !gpu_timer::supported() || section<0){
+        return;
+    }
+    slot &s = slots[frame%slot_count];
+    s.markers.push_back({section, timestamp(), -1});
+    open_markers.push_back(int(s.markers.size())-1);
+}
+
+void profiler::end_gpu()
+{
+    if(!enabled || open_markers.empty()){
+        return;
+    }
+    slot &s = slots[frame%slot_count];
+    s.markers[open_markers.back()].end_query = timestamp();
+    open_markers.pop_back();
+}
+
+void profiler::read(slot &s)
+{
+    if(s.frame<0){
+        return;
+    }
+    // The queries end in order: if the last one is available, every one is
+    int const index = s.frame%history_size;
+    GLint available = 1;
+    if(s.used>0){
+        glGetQueryObjectiv(s.queries[s.used-1], GL_QUERY_RESULT_AVAILABLE, &available);
+    }
+    if(available){
+        for(section &c : sections){
+            if(c.cpu_history[index]>=0){
+                c.gpu_history[index] = 0;
+            }
+        }
+        for(marker const& m : s.markers){
+            if(m.end_query<0){
+                continue;
+            }
+            GLuint64 t0 = 0, t1 = 0;
+            glGetQueryObjectui64v(s.queries[m.begin_query], GL_QUERY_RESULT, &t0);
+            glGetQueryObjectui64v(s.queries[m.end_query], GL_QUERY_RESULT, &t1);
+            sections[m.section].gpu_history[index] += (t1-t0)*1e-6f;
+        }
+    }
+    s.used = 0;
+    s.markers.clear();
+    s.frame = -1;
+}
+
+void profiler::next_frame()
+{
+    if(!enabled){
+        // The queries of the last measured frames are dropped, they would be read into the history much later
+        for(slot &s : slots){
+            s.used = 0;
+            s.markers.clear();
+            s.frame = -1;
+        }
+        return;
+    }
+    // Sections left open are closed so that the next frame starts clean
+    while(!open_sections.empty()){
+        end();
+    }
+    open_markers.clear();
+
+    int const index = frame%history_size;
+    for(section &s : sections){
+        // A section not opened in the frame is left out of the averages
+        s.cpu_history[index] = s.opened ? s.cpu_milliseconds : -1.0f;
+        s.gpu_history[index] = -1.0f;
+        s.cpu_milliseconds = 0;
+        s.opened = false;
+    }
+    slots[frame%slot_count].frame = frame;
+    frame++;
+    // The slot of the next frame holds the previous frame: read its results if they are there, then reuse it
+    read(slots[frame%slot_count]);
+}
+
+float profiler::average(std::vector<float> const& history) const
+{
+    float sum = 0;
+    int count = 0;
+    for(float value : history){
+        if(value>=0){
+            sum += value;
+            count++;
+        }
+    }
+    return count>0 ? sum/count : 0;
+}
+
+void profiler::display_gui()
+{
+    if(!enabled){
+        return;
+    }
+    ImGui::SetNextWindowBgAlpha(0.7f);
+    if(ImGui::Begin("Profiler", &enabled, ImGuiWindowFlags_AlwaysAutoResize)){
+        ImGui::Text("Average over %d frames (ms)", history_size);
+        for(section const& s : sections){
+            if(gpu_timer::supported()){
+                ImGui::Text("%-14s CPU %6.2f  GPU %6.2f", s.name.c_str(), average(s.cpu_history), average(s.gpu_history));
+            }
+            else{
+                ImGui::Text("%-14s CPU %6.2f", s.name.c_str(), average(s.cpu_history));
+            }
+        }
+        if(ImGui::Button("Export CSV")){
+            if(export_csv(export_path)){
+                std::cout << "profiler: timings written to " << export_path << std::endl;
+            }
+        }
+    }
+    ImGui::End();
+}
+
+bool profiler::export_csv(std::string const& path) const
+{
+    std::ofstream file(path);
+    if(!file){
+        std::cout << "profiler: cannot write " << path << std::endl;
+        return false;
+    }
+    file << "frame";
+    for(section const& s : sections){
+        file << "," << s.name << " CPU (ms)," << s.name << " GPU (ms)";
+    }
+    file << "\n";
+    int const first = std::max(0, frame-history_size);
+    for(int f=first;f<frame;f++){
+        file << f;
+        for(section const& s : sections){
+            float const cpu = s.cpu_history[f%history_size];
+            float const gpu = s.gpu_history[f%history_size];
+            file << ",";
+            if(cpu>=0){file << cpu;}
+            file << ",";
+            if(gpu>=0){file << gpu;}
+        }
+        file << "\n";
+    }
+    return bool(file);
+}
+
+profiler::scope::scope(profiler* timings, std::string const& name)
+    :owner(timings)
+{
+    if(owner!=NULL){
+        owner->begin(name);
+    }
+}
+
+profiler::scope::~scope()
+{
+    if(owner!=NULL){
+        owner->end();
+    }
+}
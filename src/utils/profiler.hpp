@@ -0,0 +1,85 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+
+// CPU and GPU time of named sections of the frame (cave, crystals, spider, debug draws...), averaged over the last frames and exportable as CSV.
+// The GPU time is measured with GL_TIMESTAMP queries around the OpenGL commands of the section, so that sections can be nested
+// (the time of a section includes its nested sections). The queries are double-buffered: the results of a frame are read at the end of
+// the next one, and a frame whose results are not available yet is skipped rather than waiting for the GPU.
+// The draws collected by a render_queue are timed when they are submitted, in the section that was open when they were pushed.
+class profiler
+{
+    public:
+        ~profiler();
+
+        bool enabled = false; // Measures and shows the overlay, closing the overlay disables it
+        std::string export_path = "profile.csv"; // Written by the export button of the overlay
+
+        // Open/close a section by name (CPU and GPU time). A section opened several times in a frame adds up its times
+        void begin(std::string const& name);
+        void end();
+        int current() const; // Innermost open section, -1 if none
+
+        // GPU time only, for the commands of a section issued after it was closed (see render_queue)
+        void begin_gpu(int section);
+        void end_gpu();
+
+        // Record the times of the frame that ended. To call once per frame, outside of any section
+        void next_frame();
+
+        void display_gui(); // Overlay window with the average times
+        bool export_csv(std::string const& path) const; // Times of the recorded frames, one line per frame
+
+        // Section open for the lifetime of the object, nothing if the profiler is NULL or disabled
+        class scope
+        {
+            public:
+                scope(profiler* timings, std::string const& name);
+                ~scope();
+            private:
+                profiler* owner;
+        };
+
+    private:
+        static int const slot_count = 2;
+        static int const history_size = 240;
+
+        struct section {
+            std::string name;
+            std::chrono::steady_clock::time_point start;
+            float cpu_milliseconds = 0; // of the current frame
+            bool opened = false; // in the current frame
+            std::vector<float> cpu_history; // per frame, negative when not measured
+            std::vector<float> gpu_history;
+        };
+        struct marker {
+            int section;
+            int begin_query;
+            int end_query;
+        };
+        // Queries of one frame
+        struct slot {
+            std::vector<GLuint> queries;
+            int used = 0;
+            std::vector<marker> markers;
+            int frame = -1;
+        };
+
+        std::vector<section> sections;
+        std::vector<int> open_sections;
+        std::vector<int> open_markers;
+        slot slots[slot_count];
+        int frame = 0;
+
+        int find(std::string const& name);
+        int timestamp(); // Index of a new timestamp query in the slot of the frame
+        void read(slot &s);
+        float average(std::vector<float> const& history) const;
+};
+
+#endif // PROFILER_HPP
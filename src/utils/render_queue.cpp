@@ -0,0 +1,263 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "../environment.hpp"
+#include "math.hpp"
+
+using namespace cgp;
+
+
+std::vector<GLuint> render_queue::prepass_programs;
+
+// Material parameters sent as uniforms
+struct material_values {
+    float values[11];
+    material_values(material_mesh_drawable_phong const& material) : values{material.color.x, material.color.y, material.color.z, material.alpha,
+        material.phong.ambient, material.phong.diffuse, material.phong.specular, material.phong.specular_exponent,
+        float(material.texture_settings.use_texture), float(material.texture_settings.texture_inverse_v), float(material.texture_settings.two_sided)} {}
+    bool operator==(material_values const& other) const {return std::equal(values, values+11, other.values);}
+};
+
+// 16 bits identifying the material (FNV-1a on its parameters)
+static uint64_t material_key(material_mesh_drawable_phong const& material)
+{
+    material_values const m(material);
+    uint32_t hash = 2166136261u;
+    unsigned char const* bytes = reinterpret_cast<unsigned char const*>(m.values);
+    for(size_t k=0;k<sizeof(m.values);k++){
+        hash = (hash^bytes[k])*16777619u;
+    }
+    return (hash^(hash>>16)) & 0xFFFF;
+}
+
+// Locations of the uniforms sent for each draw, looked up the first time a program is submitted
+struct draw_uniforms {
+    GLint model, image_texture;
+    GLint material[11]; // in the order of material_values
+};
+
+static std::unordered_map<GLuint, draw_uniforms> programs;
+
+static draw_uniforms const& get_draw_uniforms(GLuint program)
+{
+    auto found = programs.find(program);
+    if(found!=programs.end()){
+        return found->second;
+    }
+    char const* const names[11] = {"material.color", NULL, NULL, "material.alpha",
+        "material.phong.ambient", "material.phong.diffuse", "material.phong.specular", "material.phong.specular_exponent",
+        "material.texture_settings.use_texture", "material.texture_settings.texture_inverse_v", "material.texture_settings.two_sided"};
+    draw_uniforms &uniforms = programs[program];
+    uniforms.model = glGetUniformLocation(program, "model");
+    uniforms.image_texture = glGetUniformLocation(program, "image_texture");
+    for(int k=0;k<11;k++){
+        uniforms.material[k] = (names[k]!=NULL) ? glGetUniformLocation(program, names[k]) : -1;
+    }
+    return uniforms;
+}
+
+static void send_material(draw_uniforms const& uniforms, material_values const& m)
+{
+    if(uniforms.material[0]>=0){opengl_uniform(uniforms.material[0], vec3{m.values[0], m.values[1], m.values[2]});}
+    for(int k=3;k<8;k++){
+        if(uniforms.material[k]>=0){opengl_uniform(uniforms.material[k], m.values[k]);}
+    }
+    for(int k=8;k<11;k++){
+        if(uniforms.material[k]>=0){opengl_uniform(uniforms.material[k], int(m.values[k]));}
+    }
+}
+
+// Same sampler names, so the same texture units
+static bool same_samplers(mesh_drawable const& a, mesh_drawable const& b)
+{
+    if(a.supplementary_texture.size()!=b.supplementary_texture.size()){
+        return false;
+    }
+    auto it = b.supplementary_texture.begin();
+    for(auto const& texture : a.supplementary_texture){
+        if(texture.first!=it->first){return false;}
+        ++it;
+    }
+    return true;
+}
+
+// Distance to the camera on 16 bits, in 1/64 units
+static uint64_t depth_key(float distance)
+{
+    return uint64_t(std::min(std::max(distance*64.0f,0.0f),65535.0f));
+}
+
+// Model matrix sent by cgp::draw, computed the same way so that both passes have the same depth
+static mat4 model_matrix(mesh_drawable const& drawable)
+{
+    return drawable.hierarchy_transform_model.matrix() * drawable.model.matrix();
+}
+
+void render_queue::add_prepass_shader(opengl_shader_structure const& shader)
+{
+    if(std::find(prepass_programs.begin(), prepass_programs.end(), shader.id)==prepass_programs.end()){
+        prepass_programs.push_back(shader.id);
+    }
+}
+
+bool render_queue::in_prepass(item const& i) const
+{
+    mesh_drawable const& d = *i.drawable;
+    return d.material.alpha>=1 && i.instance_count==1
+        && std::find(prepass_programs.begin(), prepass_programs.end(), d.shader.id)!=prepass_programs.end();
+}
+
+void render_queue::draw_depth(environment_structure const& environment)
+{
+    if(depth_shader.id==0){
+        depth_shader.load(project::path + "shaders/depth_only/depth_only.vert.glsl", project::path + "shaders/depth_only/depth_only.frag.glsl");
+    }
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glUseProgram(depth_shader.id);
+    environment.send_opengl_uniform(depth_shader);
+    GLint const model = get_draw_uniforms(depth_shader.id).model;
+    for(item const& i : items){
+        if(!in_prepass(i)){
+            continue;
+        }
+        mesh_drawable const& d = *i.drawable;
+        opengl_uniform(model, model_matrix(d));
+        glBindVertexArray(d.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.ebo_connectivity.id);
+        glDrawElements(GL_TRIANGLES, GLsizei(3*d.ebo_connectivity.size), GL_UNSIGNED_INT, NULL);
+        draw_count++;
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void render_queue::push(mesh_drawable const& drawable, int instance_count, int section)
+{
+    if(drawable.ebo_connectivity.size==0 || instance_count<=0){
+        return;
+    }
+    items.push_back({&drawable, instance_count, section, 0});
+}
+
+void render_queue::push(hierarchy_mesh_drawable const& hierarchy, int section)
+{
+    for(hierarchy_mesh_drawable_node const& node : hierarchy.elements){
+        push(node.drawable, 1, section);
+    }
+}
+
+void render_queue::draw(environment_structure const& environment)
+{
+    // While profiling, each profiler section is submitted in one piece, to be timed
+    profiler* const timings = (environment.timings!=NULL && environment.timings->enabled) ? environment.timings : NULL;
+    bool const by_section = timings!=NULL;
+    if(by_section && !sorting){
+        std::stable_sort(items.begin(), items.end(), [](item const& a, item const& b){return a.section<b.section;});
+    }
+    if(sorting){
+        vec3 const camera = math::camera_position(environment.camera_view);
+        for(item &i : items){
+            mesh_drawable const& d = *i.drawable;
+            uint64_t const depth = depth_key(norm(d.model.translation+d.hierarchy_transform_model.translation-camera));
+            if(d.material.alpha<1){
+                i.key = (uint64_t(1)<<63) | ((0xFFFF-depth)<<47) | (uint64_t(d.shader.id&0xFFFF)<<31) | (uint64_t(d.texture.id&0xFFFF)<<15);
+            }
+            else{
+                i.key = (uint64_t(d.shader.id&0x7FFF)<<48) | (uint64_t(d.texture.id&0xFFFF)<<32) | (material_key(d.material)<<16) | depth;
+            }
+        }
+        // Stable: draws with the same key keep their order
+        std::stable_sort(items.begin(), items.end(), [by_section](item const& a, item const& b){
+            if(by_section && a.section!=b.section){return a.section<b.section;}
+            return a.key<b.key;
+        });
+    }
+
+    timer.begin();
+    draw_count = 0;
+    change_count = 0;
+    if(depth_prepass){
+        profiler::scope section(timings, "depth pre-pass");
+        draw_depth(environment);
+    }
+
+    // The fragments of the pre-pass draws are only shaded where their depth is the visible one.
+    // The program, the textures and the material are only set when they differ from the previous draw,
+    // then each draw sends its model matrix (as cgp::draw does, without rebinding everything)
+    bool equal_depth = false;
+    int section = -1;
+    mesh_drawable const* previous = NULL;
+    std::vector<GLuint> bound; // texture bound on each unit, unknown at first
+    auto bind_texture = [&](int unit, GLuint id){
+        if(unit>=int(bound.size())){bound.resize(unit+1, GLuint(-1));}
+        if(bound[unit]==id){return;}
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, id);
+        bound[unit] = id;
+        change_count++;
+    };
+    for(item const& i : items){
+        mesh_drawable const& d = *i.drawable;
+        if(timings!=NULL && i.section!=section){
+            if(section>=0){timings->end_gpu();}
+            if(i.section>=0){timings->begin_gpu(i.section);}
+            section = i.section;
+        }
+
+        bool const equal = depth_prepass && in_prepass(i);
+        if(equal!=equal_depth){
+            glDepthFunc(equal ? GL_EQUAL : GL_LESS);
+            glDepthMask(equal ? GL_FALSE : GL_TRUE);
+            equal_depth = equal;
+        }
+
+        draw_uniforms const& uniforms = get_draw_uniforms(d.shader.id);
+        bool const new_program = previous==NULL || previous->shader.id!=d.shader.id;
+        if(new_program){
+            glUseProgram(d.shader.id);
+            environment.send_opengl_uniform(d.shader);
+            if(uniforms.image_texture>=0){opengl_uniform(uniforms.image_texture, 0);}
+            change_count++;
+        }
+        bind_texture(0, d.texture.id);
+        bool const new_samplers = new_program || !same_samplers(*previous, d);
+        int unit = 1;
+        for(auto const& texture : d.supplementary_texture){
+            if(new_samplers){opengl_uniform(d.shader, texture.first, unit, false);}
+            bind_texture(unit, texture.second.id);
+            unit++;
+        }
+        material_values const material(d.material);
+        if(new_program || !(material_values(previous->material)==material)){
+            send_material(uniforms, material);
+            change_count++;
+        }
+        previous = &d;
+
+        if(uniforms.model>=0){opengl_uniform(uniforms.model, model_matrix(d));}
+        glBindVertexArray(d.vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, d.ebo_connectivity.id);
+        if(i.instance_count>1){
+            glDrawElementsInstanced(GL_TRIANGLES, GLsizei(3*d.ebo_connectivity.size), GL_UNSIGNED_INT, NULL, i.instance_count);
+        }
+        else{
+            glDrawElements(GL_TRIANGLES, GLsizei(3*d.ebo_connectivity.size), GL_UNSIGNED_INT, NULL);
+        }
+        draw_count++;
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glActiveTexture(GL_TEXTURE0);
+    if(timings!=NULL && section>=0){
+        timings->end_gpu();
+    }
+    if(equal_depth){
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+    timer.end();
+    items.clear();
+}
@@ -0,0 +1,61 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "cgp/cgp.hpp"
+#include "gpu_timer.hpp"
+
+struct environment_structure;
+
+// Draws collected during the frame and submitted together, sorted by a packed key so that the draws using the same
+// shader program, texture and material follow each other:
+//  - opaque draws: program, texture, material, then front to back
+//  - transparent draws (material alpha < 1): after the opaque ones, back to front
+// The draws are submitted directly, the program, textures and material being only set when they change.
+// The drawables are kept by pointer, they must stay alive and unchanged until draw() is called.
+// With the depth pre-pass, the opaque draws of the registered shaders first write their depth only (shaders/depth_only),
+// then are shaded with an equal depth test: the costly fragment shaders only run on the visible fragments.
+// With an enabled profiler in the environment, the draws are grouped by the profiler section they were pushed in,
+// and the GPU time of each group is added to its section.
+class render_queue
+{
+    public:
+        bool sorting = true; // When disabled the draws are submitted in the order they were pushed
+        bool depth_prepass = false;
+
+        // Shader whose vertex position is computed as in depth_only.vert.glsl (invariant gl_Position), drawn in the depth pre-pass
+        static void add_prepass_shader(cgp::opengl_shader_structure const& shader);
+
+        // section: profiler section of the draw, -1 if none
+        void push(cgp::mesh_drawable const& drawable, int instance_count = 1, int section = -1);
+        void push(cgp::hierarchy_mesh_drawable const& hierarchy, int section = -1); // Every node having a mesh (global frames already updated)
+
+        // Sort and submit the draws, then empty the queue
+        void draw(environment_structure const& environment);
+
+        // Draw calls (pre-pass included) and state changes (program binds, texture binds, material uploads) of the last submission
+        int draw_calls() const {return draw_count;}
+        int state_changes() const {return change_count;}
+        float gpu_milliseconds() const {return timer.average_milliseconds();} // GPU time of the submissions
+
+    private:
+        struct item {
+            cgp::mesh_drawable const* drawable;
+            int instance_count;
+            int section;
+            uint64_t key;
+        };
+        std::vector<item> items;
+        int draw_count = 0;
+        int change_count = 0;
+        gpu_timer timer;
+
+        static std::vector<GLuint> prepass_programs;
+        cgp::opengl_shader_structure depth_shader;
+        bool in_prepass(item const& i) const;
+        void draw_depth(environment_structure const& environment);
+};
+
+#endif // RENDER_QUEUE_HPP
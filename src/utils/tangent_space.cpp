@@ -0,0 +1,119 @@
+#include "tangent_space.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "parallel.hpp"
+
+using namespace cgp;
+
+namespace tangent_space
+{
+    // Any unit vector orthogonal to n, for vertices without usable uv
+    static vec3 orthogonal(vec3 const& n)
+    {
+        vec3 const axis = (std::abs(n.x)<0.9f) ? vec3{1,0,0} : vec3{0,1,0};
+        return normalize(cross(n,axis));
+    }
+
+    // Unnormalised tangent of a triangle, zero when its uv are degenerated
+    static vec3 triangle_tangent(mesh const& shape, uint3 const& t)
+    {
+        vec3 const edge1 = shape.position[t[1]]-shape.position[t[0]];
+        vec3 const edge2 = shape.position[t[2]]-shape.position[t[0]];
+        vec2 const delta_uv1 = shape.uv[t[1]]-shape.uv[t[0]];
+        vec2 const delta_uv2 = shape.uv[t[2]]-shape.uv[t[0]];
+        float const det = delta_uv1.x*delta_uv2.y - delta_uv2.x*delta_uv1.y;
+        if(std::abs(det)<1e-12f){
+            return {0,0,0};
+        }
+        float const f = 1.0f/det;
+        return f*(delta_uv2.y*edge1 - delta_uv1.y*edge2);
+    }
+
+    // Gram-Schmidt orthogonalize the summed tangent against the normal
+    static void orthonormalize(vec3 const& n, vec3 tangent, vec3 &t, vec3 &b)
+    {
+        tangent = tangent - dot(tangent,n)*n;
+        float const length = norm(tangent);
+        t = (length>1e-8f) ? tangent/length : orthogonal(n);
+        b = normalize(cross(n,t));
+    }
+
+    void compute(mesh const& shape, numarray<vec3> &tangents, numarray<vec3> &bitangents)
+    {
+        int const N_vertex = shape.position.size();
+        int const N_triangle = shape.connectivity.size();
+        tangents.resize(N_vertex);
+        bitangents.resize(N_vertex);
+        if(N_vertex==0){return;}
+
+        // Unnormalised tangent of each triangle
+        bool const has_uv = int(shape.uv.size())==N_vertex;
+        std::vector<vec3> per_triangle(N_triangle);
+        parallel::parallel_for(0, N_triangle, [&](int k){
+            if(!has_uv){
+                per_triangle[k] = {0,0,0};
+                return;
+            }
+            per_triangle[k] = triangle_tangent(shape,shape.connectivity[k]);
+        }, 4096);
+
+        // Triangles of each vertex (compressed rows), listed in connectivity order
+        std::vector<int> first(N_vertex+1,0);
+        for(int k=0;k<N_triangle;k++){
+            for(int c=0;c<3;c++){
+                first[shape.connectivity[k][c]+1]++;
+            }
+        }
+        for(int i=0;i<N_vertex;i++){
+            first[i+1] += first[i];
+        }
+        std::vector<int> adjacent(first[N_vertex]);
+        std::vector<int> filled(first.begin(), first.end()-1);
+        for(int k=0;k<N_triangle;k++){
+            for(int c=0;c<3;c++){
+                adjacent[filled[shape.connectivity[k][c]]++] = k;
+            }
+        }
+
+        // Each vertex sums the tangents of its triangles in that order, then orthogonalises
+        parallel::parallel_for(0, N_vertex, [&](int i){
+            vec3 tangent = {0,0,0};
+            for(int j=first[i];j<first[i+1];j++){
+                tangent += per_triangle[adjacent[j]];
+            }
+            orthonormalize(shape.normal[i],tangent,tangents[i],bitangents[i]);
+        }, 4096);
+    }
+
+    void update_region(mesh &shape, numarray<vec3> &tangents, numarray<vec3> &bitangents,
+                       std::vector<int> const& triangles, int first_vertex, int last_vertex)
+    {
+        bool const has_uv = shape.uv.size()==shape.position.size();
+        for(int i=first_vertex;i<last_vertex;i++){
+            shape.normal[i] = {0,0,0};
+            tangents[i] = {0,0,0};
+        }
+        for(int k : triangles){
+            uint3 const& t = shape.connectivity[k];
+            vec3 const& p0 = shape.position[t[0]];
+            vec3 const n = cross(shape.position[t[1]]-p0,shape.position[t[2]]-p0);
+            vec3 const tangent = has_uv ? triangle_tangent(shape,t) : vec3{0,0,0};
+            for(int c=0;c<3;c++){
+                int const i = t[c];
+                if(i<first_vertex || i>=last_vertex){continue;}
+                shape.normal[i] += n;
+                tangents[i] += tangent;
+            }
+        }
+        for(int i=first_vertex;i<last_vertex;i++){
+            float const length = norm(shape.normal[i]);
+            if(length>1e-12f){
+                shape.normal[i] = shape.normal[i]/length;
+            }
+            orthonormalize(shape.normal[i],tangents[i],tangents[i],bitangents[i]);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef TANGENT_SPACE_HPP
+#define TANGENT_SPACE_HPP
+
+#include <vector>
+
+#include "cgp/cgp.hpp"
+
+// Per-vertex tangent frames used by the normal mapping shaders (attributes 4 and 5).
+namespace tangent_space
+{
+    // The tangent of every triangle (from its positions and uv) is accumulated on its three vertices in connectivity order,
+    // then orthogonalised against the vertex normal (Gram-Schmidt). The bitangent is cross(normal,tangent)
+    // as in math::calculate_bitangent. Triangles and vertices are processed in parallel: each vertex gathers the tangents of its
+    // triangles in connectivity order, so the result does not depend on the number of threads.
+    // The mesh normals must be up to date. tangents and bitangents are resized if needed.
+    void compute(cgp::mesh const& shape, cgp::numarray<cgp::vec3> &tangents, cgp::numarray<cgp::vec3> &bitangents);
+
+    // Local update after some positions moved: normals (area weighted, as mesh::normal_update), tangents and bitangents
+    // of the vertices [first_vertex,last_vertex[ only. triangles lists, in connectivity order, every triangle using one of these vertices
+    // (triangles without any vertex in the range are allowed, they are ignored).
+    void update_region(cgp::mesh &shape, cgp::numarray<cgp::vec3> &tangents, cgp::numarray<cgp::vec3> &bitangents,
+                       std::vector<int> const& triangles, int first_vertex, int last_vertex);
+}
+
+#endif // TANGENT_SPACE_HPP
@@ -1,5 +1,7 @@
 #include "touchable_object.hpp"
 
+#include <algorithm>
+
 
 
 collision_partition::collision_partition(vec3 partition_length, vec3 _center,vec3 terrain_length){
@@ -11,7 +13,6 @@ collision_partition::collision_partition(vec3 partition_length, vec3 _center,vec
     if(terrain_length.y!=-1){N_y = terrain_length.y/y_length + 1;}
     if(terrain_length.z!=-1){N_z = terrain_length.z/z_length + 1;}
     collision_list_partition = new std::vector<collision_object*>[8*N_x*N_y*N_z+1];
-    partition_cube.initialize_data_on_gpu(mesh_primitive_cubic_grid({0,0,0},{x_length,0,0},{x_length,y_length,0},{0,y_length,0},{0,0,z_length},{x_length,0,z_length},{x_length,y_length,z_length},{0,y_length,z_length}));
 }
 collision_partition::~collision_partition(){
     delete [] collision_list_partition;
@@ -30,12 +31,19 @@ bool collision_partition::which_partition(cgp::vec3 coords, partition_coordinate
     C.z=Z;
     return true;
 }
-std::vector<collision_object*> collision_partition::get_partition(partition_coordinates C){
+int collision_partition::get_index(partition_coordinates C){
     int x=C.x;
     int y=C.y;
     int z=C.z;
     if(x>=-N_x && x<N_x && y>=-N_y && y<N_y && z>=-N_z && z<N_z){
-        return collision_list_partition[(x+N_x)*4*N_y*N_z+(y+N_y)*2*N_y+(z+N_z)];
+        return (x+N_x)*4*N_y*N_z+(y+N_y)*2*N_z+(z+N_z);
+    }
+    return -1;
+}
+std::vector<collision_object*> collision_partition::get_partition(partition_coordinates C){
+    int idx = get_index(C);
+    if(idx>=0){
+        return collision_list_partition[idx];
     }
     return out_collisions;
 }
@@ -43,22 +51,40 @@ void collision_partition::add_collision(collision_object* col){
     numarray<partition_coordinates> Cs = col->get_boxes(this);
     
     for(int i=0;i<Cs.size();i++){
-        int x=Cs[i].x;
-        int y=Cs[i].y;
-        int z=Cs[i].z;
-        if(x>=-N_x && x<N_x && y>=-N_y && y<N_y && z>=-N_z && z<N_z){
-            collision_list_partition[(x+N_x)*4*N_y*N_z+(y+N_y)*2*N_y+(z+N_z)].push_back(col);
+        int idx = get_index(Cs[i]);
+        if(idx>=0){
+            collision_list_partition[idx].push_back(col);
         }
         else{
             out_collisions.push_back(col);
         }
     }
 }
+void collision_partition::remove_collision(collision_object* col){
+    numarray<partition_coordinates> Cs = col->get_boxes(this);
+
+    for(int i=0;i<Cs.size();i++){
+        int idx = get_index(Cs[i]);
+        std::vector<collision_object*> &list = (idx>=0) ? collision_list_partition[idx] : out_collisions;
+        list.erase(std::remove(list.begin(),list.end(),col),list.end());
+    }
+}
+void collision_partition::clear(){
+    for(int i=0;i<get_size();i++){
+        collision_list_partition[i].clear();
+    }
+    out_collisions.clear();
+}
 partition_coordinates collision_partition::get_out_coordinates(){return (partition_coordinates){N_x,N_y,N_z};}
 vec3 collision_partition::get_partition_coordinates(partition_coordinates C){
-    return {x_length*C.x,y_length*C.y,z_length*C.z};
+    return center+vec3{x_length*C.x,y_length*C.y,z_length*C.z};
 }
-void collision_partition::draw(partition_coordinates C, environment_structure environment){
+void collision_partition::draw(partition_coordinates C, environment_structure const& environment){
+    // Created on the first draw only, so that partitions can be built outside of the OpenGL thread
+    if(!cube_initialized){
+        partition_cube.initialize_data_on_gpu(mesh_primitive_cubic_grid({0,0,0},{x_length,0,0},{x_length,y_length,0},{0,y_length,0},{0,0,z_length},{x_length,0,z_length},{x_length,y_length,z_length},{0,y_length,z_length}));
+        cube_initialized = true;
+    }
     partition_cube.model.translation = get_partition_coordinates(C);
     partition_cube.material.color = color;
     cgp::draw(partition_cube, environment);
@@ -26,6 +26,7 @@ private:
     std::vector<collision_object*> out_collisions;
 
     cgp::mesh_drawable partition_cube;
+    bool cube_initialized = false;
 public:
     collision_partition(vec3 partition_length = {2,2,2}, vec3 _center={0,0,0},vec3 terrain_length = {-1,-1,-1});
     ~collision_partition();
@@ -41,6 +42,8 @@ public:
     int get_N_z(){return N_z;}
 
     bool which_partition(cgp::vec3 coords, partition_coordinates &C); // returns true if the coordinate is inside the terrain length
+    int get_index(partition_coordinates C); // index of the cell in the partition, -1 if outside
+    int get_size(){return 8*N_x*N_y*N_z;}
     std::vector<collision_object*> get_partition(partition_coordinates C);
     std::vector<collision_object*> get_partition(int idx){
         if(idx<0){return out_collisions;}
@@ -48,6 +51,8 @@ public:
     }
 
     void add_collision(collision_object* col);
+    void remove_collision(collision_object* col); // Must be called before the boxes of col change
+    void clear(); // Remove every collision, the objects themselves are not deleted
     vec3 get_partition_coordinates(partition_coordinates C);
     partition_coordinates get_out_coordinates();
     math::parallelogram get_partition_face(partition_coordinates C, math::cube_face face);
@@ -55,7 +60,7 @@ public:
    
 
     
-    void draw(partition_coordinates C, environment_structure environment);
+    void draw(partition_coordinates C, environment_structure const& environment);
 };
 
 std::ostream& operator<<(std::ostream &strm,collision_partition &colpar);
@@ -71,7 +76,7 @@ public:
     ~touchable_object();
 
     void initialize(){};
-    void draw(environment_structure environment){if(environment.background_color.x){return;}};
+    void draw(environment_structure const& environment){if(environment.background_color.x){return;}};
     virtual bool goes_collide(collision_object *col){if(col==NULL){return false;}return false;};
 };
 